@@ -0,0 +1,343 @@
+#include "catalogue_image.h"
+
+#ifdef DEBUG_PRINT
+#undef DEBUG_PRINT
+#endif
+#define DEBUG_PRINT(x) \
+    do                 \
+    {                  \
+    } while (0)
+
+#include "geo.h"
+
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <fstream>
+#endif
+
+namespace serialization
+{
+
+    namespace
+    {
+        using namespace std::literals;
+
+        // Записи секции используются на месте, поэтому проверяются размер и выравнивание
+        template <typename T>
+        Records<T> AsRecords(const char *data, uint64_t size)
+        {
+            if (size % sizeof(T) != 0 || reinterpret_cast<uintptr_t>(data) % alignof(T) != 0)
+            {
+                throw FormatError("Misaligned snapshot section"s);
+            }
+            return {reinterpret_cast<const T *>(data), static_cast<size_t>(size / sizeof(T))};
+        }
+
+        geo::Coordinates ToCoordinates(const StopRecord &record)
+        {
+            return {record.lat, record.lng};
+        }
+
+    } // namespace
+
+    std::shared_ptr<const CatalogueImage> CatalogueImage::Open(const std::string &path)
+    {
+        // Отображение освобождается деструктором, даже если разбор заголовков не удался
+        std::shared_ptr<CatalogueImage> image(new CatalogueImage());
+
+#if defined(__unix__) || defined(__APPLE__)
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            throw std::runtime_error("Cannot open file for reading: "s + path);
+        }
+        struct stat info = {};
+        if (::fstat(fd, &info) != 0)
+        {
+            ::close(fd);
+            throw std::runtime_error("Cannot read file size: "s + path);
+        }
+        image->size_ = static_cast<size_t>(info.st_size);
+        if (image->size_ > 0)
+        {
+            void *data = ::mmap(nullptr, image->size_, PROT_READ, MAP_SHARED, fd, 0);
+            if (data == MAP_FAILED)
+            {
+                ::close(fd);
+                throw std::runtime_error("Cannot map file: "s + path);
+            }
+            image->data_ = static_cast<const char *>(data);
+        }
+        ::close(fd);
+#else
+        // Без mmap файл читается целиком в выровненный буфер
+        std::ifstream input(path, std::ios::binary | std::ios::ate);
+        if (!input)
+        {
+            throw std::runtime_error("Cannot open file for reading: "s + path);
+        }
+        image->size_ = static_cast<size_t>(input.tellg());
+        image->buffer_ = std::make_unique<uint64_t[]>((image->size_ + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        image->data_ = reinterpret_cast<const char *>(image->buffer_.get());
+        input.seekg(0);
+        input.read(reinterpret_cast<char *>(image->buffer_.get()), static_cast<std::streamsize>(image->size_));
+#endif
+
+        image->Index();
+        DEBUG_PRINT("Mapped catalogue image " << path << ": " << image->size_ << " bytes");
+        return image;
+    }
+
+    CatalogueImage::~CatalogueImage()
+    {
+#if defined(__unix__) || defined(__APPLE__)
+        if (data_)
+        {
+            ::munmap(const_cast<char *>(data_), size_);
+        }
+#endif
+    }
+
+    void CatalogueImage::Index()
+    {
+        FileHeader header{};
+        if (size_ < sizeof(header))
+        {
+            throw FormatError("Not a catalogue snapshot"s);
+        }
+        std::memcpy(&header, data_, sizeof(header));
+        CheckFileHeader(header);
+
+        size_t pos = sizeof(header);
+        while (pos < size_)
+        {
+            SectionHeader section{};
+            if (size_ - pos < sizeof(section))
+            {
+                throw FormatError("Truncated snapshot section"s);
+            }
+            std::memcpy(&section, data_ + pos, sizeof(section));
+            pos += sizeof(section);
+            if (section.size > size_ - pos)
+            {
+                throw FormatError("Truncated snapshot section"s);
+            }
+
+            const char *payload = data_ + pos;
+            switch (static_cast<SectionId>(section.id))
+            {
+            case SectionId::STRINGS:
+                view_.strings = std::string_view(payload, section.size);
+                break;
+            case SectionId::STOPS:
+                view_.stops = AsRecords<StopRecord>(payload, section.size);
+                break;
+            case SectionId::ROUTES:
+                view_.routes = AsRecords<RouteRecord>(payload, section.size);
+                break;
+            case SectionId::ROUTE_STOPS:
+                view_.route_stops = AsRecords<uint32_t>(payload, section.size);
+                break;
+            case SectionId::DISTANCES:
+                view_.distances = AsRecords<DistanceRecord>(payload, section.size);
+                break;
+            case SectionId::STOP_ROUTE_OFFSETS:
+                view_.stop_route_offsets = std::string_view(payload, section.size);
+                break;
+            case SectionId::STOP_ROUTES:
+                view_.stop_routes = std::string_view(payload, section.size);
+                break;
+            case SectionId::ROUTE_INFOS:
+                view_.route_infos = std::string_view(payload, section.size);
+                break;
+            case SectionId::RENDER_SETTINGS:
+                view_.render_settings = std::string_view(payload, section.size);
+                break;
+            default:
+                DEBUG_PRINT("Skipping unknown section " << section.id);
+                break;
+            }
+            pos += std::min<uint64_t>(size_ - pos, (section.size + SECTION_ALIGNMENT - 1) / SECTION_ALIGNMENT * SECTION_ALIGNMENT);
+        }
+    }
+
+    const StopRouteIndex &CatalogueImage::GetStopRouteIndex() const
+    {
+        std::call_once(stop_routes_once_, [this]
+                       {
+                           if (auto index = ReadStopRouteIndex(view_))
+                           {
+                               stop_route_index_ = *index;
+                               return;
+                           }
+                           DEBUG_PRINT("Rebuilding stop route index of the image");
+                           ComputeStopRouteIndex(view_.stops.size, view_.routes, view_.route_stops,
+                                                 computed_offsets_, computed_stop_routes_);
+                           stop_route_index_ = {{computed_offsets_.data(), computed_offsets_.size()},
+                                                {computed_stop_routes_.data(), computed_stop_routes_.size()}}; });
+        return stop_route_index_;
+    }
+
+    transport_catalogue::RouteInfo CatalogueImage::GetRouteInfo(uint32_t route) const
+    {
+        std::call_once(route_infos_once_, [this]
+                       { route_infos_ = ReadRouteInfos(view_); });
+        if (!route_infos_)
+        {
+            return ComputeRouteInfo(route);
+        }
+        if (route >= route_infos_->size)
+        {
+            throw FormatError("Route index is out of range"s);
+        }
+        const RouteInfoRecord &record = (*route_infos_)[route];
+        return {record.stops_count, record.unique_stops_count, record.route_length, record.curvature};
+    }
+
+    std::optional<uint32_t> CatalogueImage::FindStop(std::string_view name) const
+    {
+        auto it = std::lower_bound(view_.stops.begin(), view_.stops.end(), name,
+                                   [this](const StopRecord &record, std::string_view value)
+                                   { return PoolString(view_.strings, record.name_offset, record.name_size) < value; });
+        if (it == view_.stops.end() || PoolString(view_.strings, it->name_offset, it->name_size) != name)
+        {
+            return std::nullopt;
+        }
+        return static_cast<uint32_t>(it - view_.stops.begin());
+    }
+
+    std::optional<uint32_t> CatalogueImage::FindRoute(std::string_view name) const
+    {
+        auto it = std::lower_bound(view_.routes.begin(), view_.routes.end(), name,
+                                   [this](const RouteRecord &record, std::string_view value)
+                                   { return PoolString(view_.strings, record.name_offset, record.name_size) < value; });
+        if (it == view_.routes.end() || PoolString(view_.strings, it->name_offset, it->name_size) != name)
+        {
+            return std::nullopt;
+        }
+        return static_cast<uint32_t>(it - view_.routes.begin());
+    }
+
+    std::string_view CatalogueImage::GetRouteName(uint32_t route) const
+    {
+        if (route >= view_.routes.size)
+        {
+            throw FormatError("Route index is out of range"s);
+        }
+        const RouteRecord &record = view_.routes[route];
+        return PoolString(view_.strings, record.name_offset, record.name_size);
+    }
+
+    const StopRecord &CatalogueImage::GetStop(uint32_t stop) const
+    {
+        if (stop >= view_.stops.size)
+        {
+            throw FormatError("Stop index is out of range"s);
+        }
+        return view_.stops[stop];
+    }
+
+    transport_catalogue::RouteInfo CatalogueImage::ComputeRouteInfo(uint32_t route) const
+    {
+        if (route >= view_.routes.size)
+        {
+            throw FormatError("Route index is out of range"s);
+        }
+        const RouteRecord &record = view_.routes[route];
+        if (record.first_stop > view_.route_stops.size ||
+            record.stop_count > view_.route_stops.size - record.first_stop)
+        {
+            throw FormatError("Route stops are out of range"s);
+        }
+        const uint32_t *stops = view_.route_stops.data + record.first_stop;
+        const uint32_t count = record.stop_count;
+
+        // Порядок вычислений тот же, что в TransportCatalogue::ComputeRouteInfo,
+        // чтобы результаты совпадали до последнего бита
+        transport_catalogue::RouteInfo info;
+        info.stops_count = count;
+
+        std::vector<uint32_t> unique_stops(stops, stops + count);
+        std::sort(unique_stops.begin(), unique_stops.end());
+        info.unique_stops_count = std::unique(unique_stops.begin(), unique_stops.end()) - unique_stops.begin();
+
+        if (count >= 2)
+        {
+            double total_length = 0.0;
+            for (uint32_t i = 0; i + 1 < count; ++i)
+            {
+                total_length += GetDistance(stops[i], stops[i + 1]);
+            }
+            info.route_length = total_length;
+
+            double straight_length;
+            if (stops[0] == stops[count - 1])
+            {
+                straight_length = 0.0;
+                for (uint32_t i = 0; i + 1 < count; ++i)
+                {
+                    straight_length += geo::ComputeDistance(ToCoordinates(GetStop(stops[i])),
+                                                            ToCoordinates(GetStop(stops[i + 1])));
+                }
+            }
+            else
+            {
+                straight_length = geo::ComputeDistance(ToCoordinates(GetStop(stops[0])),
+                                                       ToCoordinates(GetStop(stops[count - 1])));
+            }
+            info.curvature = (straight_length > 0) ? total_length / straight_length : 1.0;
+        }
+        else
+        {
+            info.route_length = 0.0;
+            info.curvature = 1.0;
+        }
+        return info;
+    }
+
+    double CatalogueImage::GetDistance(uint32_t from, uint32_t to) const
+    {
+        auto find = [this](uint32_t lhs, uint32_t rhs) -> const DistanceRecord *
+        {
+            auto it = std::lower_bound(view_.distances.begin(), view_.distances.end(), std::make_pair(lhs, rhs),
+                                       [](const DistanceRecord &record, const std::pair<uint32_t, uint32_t> &key)
+                                       { return std::tie(record.from, record.to) < std::tie(key.first, key.second); });
+            return it != view_.distances.end() && it->from == lhs && it->to == rhs ? it : nullptr;
+        };
+
+        if (const DistanceRecord *record = find(from, to))
+        {
+            return record->distance;
+        }
+        if (const DistanceRecord *record = find(to, from))
+        {
+            return record->distance;
+        }
+        return geo::ComputeDistance(ToCoordinates(GetStop(from)), ToCoordinates(GetStop(to)));
+    }
+
+    map_renderer::RenderSettings CatalogueImage::GetRenderSettings() const
+    {
+        if (view_.render_settings.empty())
+        {
+            return {};
+        }
+        return DecodeRenderSettings(view_.render_settings);
+    }
+
+    void CatalogueImage::LoadInto(transport_catalogue::TransportCatalogue &catalogue) const
+    {
+        BuildCatalogue(view_, catalogue);
+    }
+
+} // namespace serialization
@@ -0,0 +1,101 @@
+#pragma once
+
+/*
+ * Образ каталога: снимок формата SaveCatalogue, отображённый в память только для чтения.
+ *
+ * При открытии проверяются только заголовок и таблица секций, поэтому время запуска
+ * не зависит от размера каталога. Запросы выполняются прямо по записям снимка:
+ * остановки и маршруты ищутся двоичным поиском по таблицам, упорядоченным по имени,
+ * расстояния - по таблице, упорядоченной по паре индексов. Страницы файла разделяются
+ * всеми процессами, отобразившими один и тот же образ.
+ * Производные индексы снимка (маршруты через остановку, статистика маршрутов) проверяются
+ * при первом использовании и пересчитываются, только если непригодны.
+ */
+
+#include "map_renderer.h"
+#include "serialization.h"
+#include "transport_catalogue.h"
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace serialization
+{
+
+    class CatalogueImage
+    {
+    public:
+        // Отображает файл снимка. Бросает FormatError, если файл не является снимком
+        // поддерживаемой версии
+        static std::shared_ptr<const CatalogueImage> Open(const std::string &path);
+
+        ~CatalogueImage();
+
+        CatalogueImage(const CatalogueImage &) = delete;
+        CatalogueImage &operator=(const CatalogueImage &) = delete;
+
+        // Индексы остановки и маршрута в таблицах снимка
+        std::optional<uint32_t> FindStop(std::string_view name) const;
+        std::optional<uint32_t> FindRoute(std::string_view name) const;
+
+        std::string_view GetRouteName(uint32_t route) const;
+
+        // Перебирает имена маршрутов через остановку в порядке имён
+        template <typename Func>
+        void ForEachRouteThrough(uint32_t stop, Func func) const
+        {
+            const StopRouteIndex &index = GetStopRouteIndex();
+            if (stop >= view_.stops.size)
+            {
+                throw FormatError("Stop index is out of range");
+            }
+            for (uint32_t i = index.offsets[stop]; i < index.offsets[stop + 1]; ++i)
+            {
+                func(GetRouteName(index.routes[i]));
+            }
+        }
+
+        // Статистика маршрута: из снимка или вычисленная по его записям
+        transport_catalogue::RouteInfo GetRouteInfo(uint32_t route) const;
+        transport_catalogue::RouteInfo ComputeRouteInfo(uint32_t route) const;
+
+        // Расстояние так же, как в TransportCatalogue: прямое, обратное или географическое
+        double GetDistance(uint32_t from, uint32_t to) const;
+
+        map_renderer::RenderSettings GetRenderSettings() const;
+
+        // Заполняет пустой каталог полной копией образа
+        void LoadInto(transport_catalogue::TransportCatalogue &catalogue) const;
+
+    private:
+        CatalogueImage() = default;
+
+        // Разбирает заголовок и таблицу секций отображённого файла
+        void Index();
+
+        // Производные индексы проверяются при первом обращении, поэтому время открытия
+        // не зависит от их числа. Непригодный индекс пересчитывается в память процесса
+        const StopRouteIndex &GetStopRouteIndex() const;
+        const StopRecord &GetStop(uint32_t stop) const;
+
+        // Начало и размер отображения (или буфера, если отображение недоступно)
+        const char *data_ = nullptr;
+        size_t size_ = 0;
+        std::unique_ptr<uint64_t[]> buffer_;
+        SnapshotView view_;
+
+        mutable std::once_flag stop_routes_once_;
+        mutable StopRouteIndex stop_route_index_;
+        mutable std::vector<uint32_t> computed_offsets_;
+        mutable std::vector<uint32_t> computed_stop_routes_;
+
+        mutable std::once_flag route_infos_once_;
+        mutable std::optional<Records<RouteInfoRecord>> route_infos_;
+    };
+
+} // namespace serialization
@@ -0,0 +1,427 @@
+#include "delta.h"
+
+#ifdef DEBUG_PRINT
+#undef DEBUG_PRINT
+#endif
+#define DEBUG_PRINT(x) \
+    do                 \
+    {                  \
+    } while (0)
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <memory>
+#include <stdexcept>
+#include <string_view>
+#include <unordered_map>
+
+namespace serialization
+{
+
+    namespace
+    {
+        using namespace std::literals;
+
+        constexpr char DELTA_MAGIC[8] = {'T', 'C', 'D', 'E', 'L', 'T', 'A', '\0'};
+
+        static_assert(sizeof(NameRecord) == 8);
+        static_assert(sizeof(NamedDistanceRecord) == 24);
+        static_assert(sizeof(NamePairRecord) == 16);
+
+        uint32_t CheckedSize(size_t size)
+        {
+            if (size > std::numeric_limits<uint32_t>::max())
+            {
+                throw FormatError("Delta is too large for the delta format"s);
+            }
+            return static_cast<uint32_t>(size);
+        }
+
+        // Пул строк дельты: одно и то же имя хранится один раз
+        class PoolBuilder
+        {
+        public:
+            NameRecord Add(std::string_view name)
+            {
+                auto [it, inserted] = names_.emplace(name, NameRecord{});
+                if (inserted)
+                {
+                    it->second = {CheckedSize(data_.size()), CheckedSize(name.size())};
+                    data_ += name;
+                }
+                return it->second;
+            }
+
+            const std::string &GetData() const
+            {
+                return data_;
+            }
+
+        private:
+            std::string data_;
+            std::unordered_map<std::string, NameRecord> names_;
+        };
+
+        template <typename T>
+        void WriteRecords(std::ostream &output, DeltaSectionId id, const std::vector<T> &records)
+        {
+            WriteSection(output, static_cast<uint32_t>(id),
+                         std::string_view(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(T)));
+        }
+
+        template <typename T>
+        std::vector<T> ToRecords(std::string_view data)
+        {
+            if (data.size() % sizeof(T) != 0)
+            {
+                throw FormatError("Section size is not a multiple of its record size"s);
+            }
+            std::vector<T> records(data.size() / sizeof(T));
+            if (!data.empty())
+            {
+                std::memcpy(records.data(), data.data(), data.size());
+            }
+            return records;
+        }
+
+        std::string ToName(std::string_view pool, const NameRecord &record)
+        {
+            return std::string(PoolString(pool, record.offset, record.size));
+        }
+
+        template <typename T>
+        void SortByName(std::vector<const T *> &items)
+        {
+            std::sort(items.begin(), items.end(), [](const T *lhs, const T *rhs)
+                      { return lhs->name < rhs->name; });
+        }
+
+        bool SameStops(const Route &lhs, const Route &rhs)
+        {
+            return std::equal(lhs.stops.begin(), lhs.stops.end(), rhs.stops.begin(), rhs.stops.end(),
+                              [](const Stop *a, const Stop *b)
+                              { return a->name == b->name; });
+        }
+
+        using NamedDistances = std::map<std::pair<std::string_view, std::string_view>, double>;
+
+        NamedDistances CollectDistances(const transport_catalogue::TransportCatalogue &catalogue)
+        {
+            NamedDistances distances;
+            catalogue.ForEachDistance([&distances](const Stop *from, const Stop *to, double distance)
+                                      { distances.emplace(std::make_pair(std::string_view(from->name), std::string_view(to->name)), distance); });
+            return distances;
+        }
+
+    } // namespace
+
+    bool CatalogueDelta::Empty() const
+    {
+        return stops.empty() && removed_stops.empty() && routes.empty() && removed_routes.empty() &&
+               distances.empty() && removed_distances.empty();
+    }
+
+    CatalogueDelta ComputeDelta(const transport_catalogue::TransportCatalogue &from,
+                                const transport_catalogue::TransportCatalogue &to)
+    {
+        const domain::StopContainer &old_stops = from.GetStopContainer();
+        const domain::StopContainer &new_stops = to.GetStopContainer();
+        const domain::RouteContainer &old_routes = from.GetRouteContainer();
+        const domain::RouteContainer &new_routes = to.GetRouteContainer();
+        CatalogueDelta delta;
+
+        // Объекты перебираются по имени, чтобы дельта не зависела от порядка в хэш-таблицах
+        std::vector<const Stop *> stops = new_stops.GetAllStops();
+        SortByName(stops);
+        for (const Stop *stop : stops)
+        {
+            const Stop *old_stop = old_stops.GetStop(stop->name);
+            if (!old_stop || old_stop->coordinates != stop->coordinates)
+            {
+                delta.stops.push_back({stop->name, stop->coordinates});
+            }
+        }
+        stops = old_stops.GetAllStops();
+        SortByName(stops);
+        for (const Stop *stop : stops)
+        {
+            if (!new_stops.Exists(stop->name))
+            {
+                delta.removed_stops.push_back(stop->name);
+            }
+        }
+
+        std::vector<const Route *> routes = new_routes.GetAllRoutes();
+        SortByName(routes);
+        for (const Route *route : routes)
+        {
+            const Route *old_route = old_routes.GetRoute(route->name);
+            if (old_route && old_route->is_roundtrip == route->is_roundtrip && SameStops(*old_route, *route))
+            {
+                continue;
+            }
+            CatalogueDelta::RouteChange change{route->name, {}, route->is_roundtrip};
+            change.stops.reserve(route->stops.size());
+            for (const Stop *stop : route->stops)
+            {
+                change.stops.push_back(stop->name);
+            }
+            delta.routes.push_back(std::move(change));
+        }
+        routes = old_routes.GetAllRoutes();
+        SortByName(routes);
+        for (const Route *route : routes)
+        {
+            if (!new_routes.Exists(route->name))
+            {
+                delta.removed_routes.push_back(route->name);
+            }
+        }
+
+        const NamedDistances old_distances = CollectDistances(from);
+        const NamedDistances new_distances = CollectDistances(to);
+        for (const auto &[stops_pair, distance] : new_distances)
+        {
+            auto it = old_distances.find(stops_pair);
+            if (it == old_distances.end() || it->second != distance)
+            {
+                delta.distances.push_back({std::string(stops_pair.first), std::string(stops_pair.second), distance});
+            }
+        }
+        for (const auto &[stops_pair, distance] : old_distances)
+        {
+            // Расстояния удалённых остановок удаляются вместе с ними
+            if (!new_distances.count(stops_pair) && new_stops.Exists(stops_pair.first) &&
+                new_stops.Exists(stops_pair.second))
+            {
+                delta.removed_distances.emplace_back(stops_pair.first, stops_pair.second);
+            }
+        }
+
+        DEBUG_PRINT("Delta: " << delta.stops.size() << " stops, " << delta.routes.size() << " routes, "
+                              << delta.distances.size() << " distances changed");
+        return delta;
+    }
+
+    void ApplyDelta(const CatalogueDelta &delta, transport_catalogue::TransportCatalogue &catalogue)
+    {
+        // Порядок выбран так, чтобы каждый шаг ссылался только на существующие объекты:
+        // маршруты удаляются до остановок, а добавляются после остановок и расстояний
+        for (const std::string &name : delta.removed_routes)
+        {
+            catalogue.RemoveRoute(name);
+        }
+
+        std::vector<transport_catalogue::StopInput> stops;
+        stops.reserve(delta.stops.size());
+        for (const CatalogueDelta::StopChange &stop : delta.stops)
+        {
+            stops.push_back({stop.name, stop.coordinates});
+        }
+        catalogue.AddStops(stops);
+
+        for (const auto &[from, to] : delta.removed_distances)
+        {
+            catalogue.RemoveDistance(from, to);
+        }
+        std::vector<transport_catalogue::DistanceInput> distances;
+        distances.reserve(delta.distances.size());
+        for (const CatalogueDelta::DistanceChange &distance : delta.distances)
+        {
+            distances.push_back({distance.from, distance.to, distance.distance});
+        }
+        catalogue.AddDistances(distances);
+
+        std::vector<std::unique_ptr<Route>> routes;
+        routes.reserve(delta.routes.size());
+        for (const CatalogueDelta::RouteChange &change : delta.routes)
+        {
+            auto route = std::make_unique<Route>();
+            route->name = change.name;
+            route->is_roundtrip = change.is_roundtrip;
+            route->stops.reserve(change.stops.size());
+            for (const std::string &stop_name : change.stops)
+            {
+                const Stop *stop = catalogue.GetStopContainer().GetStop(stop_name);
+                if (!stop)
+                {
+                    throw std::invalid_argument("Stop not found: " + stop_name);
+                }
+                route->stops.push_back(stop);
+            }
+            routes.push_back(std::move(route));
+        }
+        catalogue.AddPreparedRoutes(std::move(routes));
+
+        for (const std::string &name : delta.removed_stops)
+        {
+            catalogue.RemoveStop(name);
+        }
+    }
+
+    void SaveDelta(std::ostream &output, const CatalogueDelta &delta)
+    {
+        PoolBuilder pool;
+
+        std::vector<StopRecord> stops;
+        stops.reserve(delta.stops.size());
+        for (const CatalogueDelta::StopChange &stop : delta.stops)
+        {
+            const NameRecord name = pool.Add(stop.name);
+            stops.push_back({name.offset, name.size, stop.coordinates.lat, stop.coordinates.lng});
+        }
+
+        std::vector<RouteRecord> routes;
+        std::vector<NameRecord> route_stops;
+        routes.reserve(delta.routes.size());
+        for (const CatalogueDelta::RouteChange &route : delta.routes)
+        {
+            const NameRecord name = pool.Add(route.name);
+            routes.push_back({name.offset, name.size, CheckedSize(route_stops.size()), CheckedSize(route.stops.size()),
+                              route.is_roundtrip ? 1u : 0u, 0});
+            for (const std::string &stop : route.stops)
+            {
+                route_stops.push_back(pool.Add(stop));
+            }
+        }
+
+        std::vector<NamedDistanceRecord> distances;
+        distances.reserve(delta.distances.size());
+        for (const CatalogueDelta::DistanceChange &distance : delta.distances)
+        {
+            distances.push_back({pool.Add(distance.from), pool.Add(distance.to), distance.distance});
+        }
+
+        auto add_names = [&pool](const std::vector<std::string> &names)
+        {
+            std::vector<NameRecord> records;
+            records.reserve(names.size());
+            for (const std::string &name : names)
+            {
+                records.push_back(pool.Add(name));
+            }
+            return records;
+        };
+        const std::vector<NameRecord> removed_stops = add_names(delta.removed_stops);
+        const std::vector<NameRecord> removed_routes = add_names(delta.removed_routes);
+
+        std::vector<NamePairRecord> removed_distances;
+        removed_distances.reserve(delta.removed_distances.size());
+        for (const auto &[from, to] : delta.removed_distances)
+        {
+            removed_distances.push_back({pool.Add(from), pool.Add(to)});
+        }
+
+        WriteFileHeader(output, DELTA_MAGIC, DELTA_FORMAT_VERSION);
+        WriteSection(output, static_cast<uint32_t>(DeltaSectionId::STRINGS), pool.GetData());
+        WriteRecords(output, DeltaSectionId::STOPS, stops);
+        WriteRecords(output, DeltaSectionId::REMOVED_STOPS, removed_stops);
+        WriteRecords(output, DeltaSectionId::ROUTES, routes);
+        WriteRecords(output, DeltaSectionId::ROUTE_STOPS, route_stops);
+        WriteRecords(output, DeltaSectionId::REMOVED_ROUTES, removed_routes);
+        WriteRecords(output, DeltaSectionId::DISTANCES, distances);
+        WriteRecords(output, DeltaSectionId::REMOVED_DISTANCES, removed_distances);
+
+        if (!output)
+        {
+            throw std::runtime_error("Failed to write catalogue delta"s);
+        }
+    }
+
+    void SaveDelta(const std::string &path, const CatalogueDelta &delta)
+    {
+        std::ofstream output(path, std::ios::binary | std::ios::trunc);
+        if (!output)
+        {
+            throw std::runtime_error("Cannot open file for writing: "s + path);
+        }
+        SaveDelta(output, delta);
+    }
+
+    CatalogueDelta LoadDelta(std::istream &input)
+    {
+        FileHeader header{};
+        if (!input.read(reinterpret_cast<char *>(&header), sizeof(header)))
+        {
+            throw FormatError("Not a catalogue delta"s);
+        }
+        CheckFileHeader(header, DELTA_MAGIC, DELTA_FORMAT_VERSION);
+
+        // Дельта невелика, поэтому секции читаются целиком и разбираются после чтения
+        std::unordered_map<uint32_t, std::string> sections;
+        SectionHeader section{};
+        while (input.read(reinterpret_cast<char *>(&section), sizeof(section)))
+        {
+            CheckSectionSize(input, section.size);
+            std::string &data = sections[section.id];
+            data.assign(section.size, '\0');
+            input.read(data.data(), static_cast<std::streamsize>(section.size));
+            input.ignore(static_cast<std::streamsize>((SECTION_ALIGNMENT - section.size % SECTION_ALIGNMENT) % SECTION_ALIGNMENT));
+            if (!input)
+            {
+                throw FormatError("Truncated delta section"s);
+            }
+        }
+        auto records = [&sections](DeltaSectionId id)
+        {
+            return std::string_view(sections[static_cast<uint32_t>(id)]);
+        };
+        const std::string pool(records(DeltaSectionId::STRINGS));
+
+        CatalogueDelta delta;
+        for (const StopRecord &record : ToRecords<StopRecord>(records(DeltaSectionId::STOPS)))
+        {
+            delta.stops.push_back({std::string(PoolString(pool, record.name_offset, record.name_size)),
+                                   {record.lat, record.lng}});
+        }
+        for (const NameRecord &record : ToRecords<NameRecord>(records(DeltaSectionId::REMOVED_STOPS)))
+        {
+            delta.removed_stops.push_back(ToName(pool, record));
+        }
+
+        const std::vector<NameRecord> route_stops = ToRecords<NameRecord>(records(DeltaSectionId::ROUTE_STOPS));
+        for (const RouteRecord &record : ToRecords<RouteRecord>(records(DeltaSectionId::ROUTES)))
+        {
+            if (record.first_stop > route_stops.size() || record.stop_count > route_stops.size() - record.first_stop)
+            {
+                throw FormatError("Route stops are out of range"s);
+            }
+            CatalogueDelta::RouteChange route{std::string(PoolString(pool, record.name_offset, record.name_size)), {},
+                                              record.is_roundtrip != 0};
+            route.stops.reserve(record.stop_count);
+            for (uint32_t i = 0; i < record.stop_count; ++i)
+            {
+                route.stops.push_back(ToName(pool, route_stops[record.first_stop + i]));
+            }
+            delta.routes.push_back(std::move(route));
+        }
+        for (const NameRecord &record : ToRecords<NameRecord>(records(DeltaSectionId::REMOVED_ROUTES)))
+        {
+            delta.removed_routes.push_back(ToName(pool, record));
+        }
+
+        for (const NamedDistanceRecord &record : ToRecords<NamedDistanceRecord>(records(DeltaSectionId::DISTANCES)))
+        {
+            delta.distances.push_back({ToName(pool, record.from), ToName(pool, record.to), record.distance});
+        }
+        for (const NamePairRecord &record : ToRecords<NamePairRecord>(records(DeltaSectionId::REMOVED_DISTANCES)))
+        {
+            delta.removed_distances.emplace_back(ToName(pool, record.from), ToName(pool, record.to));
+        }
+        return delta;
+    }
+
+    CatalogueDelta LoadDelta(const std::string &path)
+    {
+        std::ifstream input(path, std::ios::binary);
+        if (!input)
+        {
+            throw std::runtime_error("Cannot open file for reading: "s + path);
+        }
+        return LoadDelta(input);
+    }
+
+} // namespace serialization
@@ -0,0 +1,109 @@
+#pragma once
+
+/*
+ * Дельта каталога: добавленные, изменённые и удалённые остановки, маршруты и расстояния
+ * между двумя версиями базы.
+ *
+ * Файл дельты устроен так же, как снимок (заголовок и выровненные секции), но имеет свою
+ * сигнатуру и версию. Объекты ссылаются друг на друга по именам, а не по индексам,
+ * поэтому дельту можно применить к любому каталогу, содержащему исходную версию.
+ * Размер дельты и время её применения зависят только от числа изменений.
+ */
+
+#include "serialization.h"
+#include "transport_catalogue.h"
+
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace serialization
+{
+
+    constexpr uint32_t DELTA_FORMAT_VERSION = 1;
+
+    enum class DeltaSectionId : uint32_t
+    {
+        STRINGS = 1,
+        // Добавленные или изменённые остановки (StopRecord)
+        STOPS = 2,
+        REMOVED_STOPS = 3,
+        // Добавленные или изменённые маршруты (RouteRecord), остановки маршрутов - именами
+        ROUTES = 4,
+        ROUTE_STOPS = 5,
+        REMOVED_ROUTES = 6,
+        DISTANCES = 7,
+        REMOVED_DISTANCES = 8,
+    };
+
+    // Имя в пуле строк дельты
+    struct NameRecord
+    {
+        uint32_t offset;
+        uint32_t size;
+    };
+
+    struct NamedDistanceRecord
+    {
+        NameRecord from;
+        NameRecord to;
+        double distance;
+    };
+
+    struct NamePairRecord
+    {
+        NameRecord from;
+        NameRecord to;
+    };
+
+    struct CatalogueDelta
+    {
+        struct StopChange
+        {
+            std::string name;
+            geo::Coordinates coordinates;
+        };
+
+        struct RouteChange
+        {
+            std::string name;
+            // Остановки в порядке проезда, включая обратный путь
+            std::vector<std::string> stops;
+            bool is_roundtrip = false;
+        };
+
+        struct DistanceChange
+        {
+            std::string from;
+            std::string to;
+            double distance;
+        };
+
+        std::vector<StopChange> stops;
+        std::vector<std::string> removed_stops;
+        std::vector<RouteChange> routes;
+        std::vector<std::string> removed_routes;
+        std::vector<DistanceChange> distances;
+        std::vector<std::pair<std::string, std::string>> removed_distances;
+
+        bool Empty() const;
+    };
+
+    // Изменения, переводящие каталог from в каталог to
+    CatalogueDelta ComputeDelta(const transport_catalogue::TransportCatalogue &from,
+                                const transport_catalogue::TransportCatalogue &to);
+
+    // Применяет дельту к изменяемому каталогу. Построенные индексы обновляются
+    // инкрементально, только для затронутых остановок и маршрутов
+    void ApplyDelta(const CatalogueDelta &delta, transport_catalogue::TransportCatalogue &catalogue);
+
+    void SaveDelta(std::ostream &output, const CatalogueDelta &delta);
+    void SaveDelta(const std::string &path, const CatalogueDelta &delta);
+
+    CatalogueDelta LoadDelta(std::istream &input);
+    CatalogueDelta LoadDelta(const std::string &path);
+
+} // namespace serialization
@@ -23,6 +23,7 @@
     } while (0)
 
 #include <string>
+#include <string_view>
 #include <vector>
 #include <unordered_map>
 #include <optional>
@@ -48,30 +49,59 @@ struct Route
 namespace domain
 {
 
-    // Базовый класс-контейнер
+    // Базовый класс-контейнер.
+    // Ключ - представление имени, хранящегося в самом элементе, поэтому каждое имя
+    // размещается в памяти ровно один раз. Элементы хранятся по указателю и не перемещаются
     template <typename T>
     class Container
     {
     protected:
-        std::unordered_map<std::string, std::unique_ptr<T>> items_;
+        std::unordered_map<std::string_view, std::unique_ptr<T>> items_;
+
+        // Поместить элемент в контейнер, заменив элемент с тем же именем.
+        // Старая запись удаляется до вставки, чтобы ключ не ссылался на имя удалённого элемента
+        void Emplace(std::unique_ptr<T> item)
+        {
+            const std::string_view key = item->name;
+            items_.erase(key);
+            items_.emplace(key, std::move(item));
+        }
 
     public:
         virtual ~Container() = default;
 
         // Проверить существование элемента
-        virtual bool Exists(const std::string &name) const
+        virtual bool Exists(std::string_view name) const
         {
             bool exists = items_.find(name) != items_.end();
             DEBUG_PRINT("Checking existence of '" << name << "': " << (exists ? "true" : "false"));
             return exists;
         }
 
+        // Зарезервировать место под count элементов
+        void Reserve(size_t count)
+        {
+            items_.reserve(count);
+        }
+
+        size_t Size() const
+        {
+            return items_.size();
+        }
+
+        // Удалить элемент. Возвращает false, если элемента нет
+        bool Remove(std::string_view name)
+        {
+            DEBUG_PRINT("Removing item: " << name);
+            return items_.erase(name) > 0;
+        }
+
     protected:
         // Добавить элемент
         virtual void Add(std::unique_ptr<T> item) = 0;
 
         // Получить элемент по имени
-        virtual const T *Get(const std::string &name) const
+        virtual const T *Get(std::string_view name) const
         {
             auto it = items_.find(name);
             if (it != items_.end())
@@ -91,14 +121,20 @@ namespace domain
     class StopContainer : public Container<Stop>
     {
     public:
-        // Добавить остановку
+        // Добавить остановку. Если остановка с таким именем уже есть, обновляются
+        // её координаты, чтобы указатели на неё из маршрутов оставались действительными
         void Add(std::unique_ptr<Stop> stop) override
         {
             if (stop && !stop->name.empty())
             {
                 DEBUG_PRINT("Adding stop: " << stop->name
                                             << " at (" << stop->coordinates.lat << ", " << stop->coordinates.lng << ")");
-                items_[stop->name] = std::move(stop);
+                if (auto it = items_.find(stop->name); it != items_.end())
+                {
+                    it->second->coordinates = stop->coordinates;
+                    return;
+                }
+                Emplace(std::move(stop));
             }
             else
             {
@@ -107,23 +143,40 @@ namespace domain
         }
 
         // Получить остановку по имени
-        const Stop *GetStop(const std::string &name) const
+        const Stop *GetStop(std::string_view name) const
         {
             DEBUG_PRINT("GetStop: " << name);
             return Get(name);
         }
 
         // Добавить остановку с координатами
-        void AddStop(const std::string &name, double lat, double lng)
+        void AddStop(std::string_view name, double lat, double lng)
         {
             DEBUG_PRINT("AddStop: " << name << " (" << lat << ", " << lng << ")");
+            if (auto it = items_.find(name); it != items_.end())
+            {
+                it->second->coordinates = {lat, lng};
+                return;
+            }
             auto stop = std::make_unique<Stop>();
-            stop->name = name;
+            stop->name = std::string(name);
             stop->coordinates.lat = lat;
             stop->coordinates.lng = lng;
             Add(std::move(stop));
         }
 
+        // Изменить координаты существующей остановки. Возвращает false, если остановки нет
+        bool SetCoordinates(std::string_view name, geo::Coordinates coordinates)
+        {
+            auto it = items_.find(name);
+            if (it == items_.end())
+            {
+                return false;
+            }
+            it->second->coordinates = coordinates;
+            return true;
+        }
+
         // Получить все остановки
         std::vector<const Stop *> GetAllStops() const
         {
@@ -154,7 +207,7 @@ namespace domain
             if (route && !route->name.empty())
             {
                 DEBUG_PRINT("Adding route: " << route->name << " with " << route->stops.size() << " stops");
-                items_[route->name] = std::move(route);
+                Emplace(std::move(route));
             }
             else
             {
@@ -163,26 +216,37 @@ namespace domain
         }
 
         // Получить маршрут по имени
-        const Route *GetRoute(const std::string &name) const
+        const Route *GetRoute(std::string_view name) const
         {
             DEBUG_PRINT("GetRoute: " << name);
             return Get(name);
         }
 
-        // Создать и добавить маршрут
-        void AddRoute(const std::string &name, const std::vector<std::string> &stop_names, bool is_roundtrip = false)
+        // Создать и добавить маршрут. StopNames - последовательность имён остановок
+        // (std::string или std::string_view); имена только ищутся и не копируются
+        template <typename StopNames>
+        void AddRoute(std::string_view name, const StopNames &stop_names, bool is_roundtrip = false)
+        {
+            Add(MakeRoute(name, stop_names, is_roundtrip));
+        }
+
+        // Создать маршрут, не добавляя его. Только читает контейнер остановок,
+        // поэтому может вызываться из нескольких потоков одновременно
+        template <typename StopNames>
+        std::unique_ptr<Route> MakeRoute(std::string_view name, const StopNames &stop_names, bool is_roundtrip = false) const
         {
-            DEBUG_PRINT("AddRoute: " << name << " with " << stop_names.size() << " stop names, roundtrip: " << is_roundtrip);
+            DEBUG_PRINT("MakeRoute: " << name << " with " << stop_names.size() << " stop names, roundtrip: " << is_roundtrip);
             auto route = std::make_unique<Route>();
-            route->name = name;
+            route->name = std::string(name);
             route->is_roundtrip = is_roundtrip;
+            route->stops.reserve(is_roundtrip ? stop_names.size() : 2 * stop_names.size());
 
             // Добавляем остановки в маршрут
             for (const auto &stop_name : stop_names)
             {
-                if (stop_container_ && stop_container_->Exists(stop_name))
+                if (const Stop *stop = stop_container_ ? stop_container_->GetStop(stop_name) : nullptr)
                 {
-                    route->stops.push_back(stop_container_->GetStop(stop_name));
+                    route->stops.push_back(stop);
                     DEBUG_PRINT("Added stop '" << stop_name << "' to route '" << name << "'");
                 }
                 else
@@ -200,15 +264,15 @@ namespace domain
                 for (int i = static_cast<int>(stop_names.size()) - 2; i >= 0; --i)
                 {
                     const auto &stop_name = stop_names[i];
-                    if (stop_container_ && stop_container_->Exists(stop_name))
+                    if (const Stop *stop = stop_container_ ? stop_container_->GetStop(stop_name) : nullptr)
                     {
-                        route->stops.push_back(stop_container_->GetStop(stop_name));
+                        route->stops.push_back(stop);
                         DEBUG_PRINT("Added return stop '" << stop_name << "' to route '" << name << "'");
                     }
                 }
             }
 
-            Add(std::move(route));
+            return route;
         }
 
         // Получить все маршруты
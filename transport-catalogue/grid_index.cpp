@@ -0,0 +1,147 @@
+#include "grid_index.h"
+#include <algorithm>
+#include <cmath>
+
+namespace map_renderer {
+
+namespace {
+
+// Наибольшее число ячеек по одной стороне сетки
+constexpr size_t MAX_GRID_SIDE = 1024;
+
+size_t ClampSide(double side) {
+    if (!(side >= 1.0)) {
+        return 1;
+    }
+    return std::min(static_cast<size_t>(std::ceil(side)), MAX_GRID_SIDE);
+}
+
+} // namespace
+
+GridIndex::GridIndex(const std::vector<Segment>& segments) {
+    if (segments.empty()) {
+        return;
+    }
+
+    bounds_ = {segments.front().x0, segments.front().y0, segments.front().x0, segments.front().y0};
+    for (const Segment& segment : segments) {
+        bounds_.min_x = std::min({bounds_.min_x, segment.x0, segment.x1});
+        bounds_.min_y = std::min({bounds_.min_y, segment.y0, segment.y1});
+        bounds_.max_x = std::max({bounds_.max_x, segment.x0, segment.x1});
+        bounds_.max_y = std::max({bounds_.max_y, segment.y0, segment.y1});
+    }
+
+    // Ячейки близки к квадратным, в среднем по одному объекту на ячейку
+    const double count = static_cast<double>(segments.size());
+    const double width = bounds_.max_x - bounds_.min_x;
+    const double height = bounds_.max_y - bounds_.min_y;
+    if (width > 0 && height > 0) {
+        columns_ = ClampSide(std::sqrt(count * width / height));
+        rows_ = ClampSide(std::sqrt(count * height / width));
+    } else {
+        // Все объекты на одной линии: сетка вырождается в ряд ячеек
+        columns_ = width > 0 ? ClampSide(count) : 1;
+        rows_ = height > 0 ? ClampSide(count) : 1;
+    }
+    cell_width_ = width / static_cast<double>(columns_);
+    cell_height_ = height / static_cast<double>(rows_);
+
+    // Два прохода: сначала число объектов в каждой ячейке, затем сами объекты
+    cell_starts_.assign(columns_ * rows_ + 1, 0);
+    for (const Segment& segment : segments) {
+        ForEachCell(segment, [this](size_t cell) {
+            ++cell_starts_[cell + 1];
+        });
+    }
+    for (size_t i = 1; i < cell_starts_.size(); ++i) {
+        cell_starts_[i] += cell_starts_[i - 1];
+    }
+
+    items_.resize(cell_starts_.back());
+    std::vector<uint32_t> next(cell_starts_.begin(), cell_starts_.end() - 1);
+    for (uint32_t item = 0; item < segments.size(); ++item) {
+        ForEachCell(segments[item], [this, &next, item](size_t cell) {
+            items_[next[cell]++] = item;
+        });
+    }
+}
+
+std::vector<uint32_t> GridIndex::Query(const Rect& rect) const {
+    std::vector<uint32_t> result;
+    size_t min_column, max_column, min_row, max_row;
+    if (!GetCells(rect, min_column, max_column, min_row, max_row)) {
+        return result;
+    }
+
+    for (size_t row = min_row; row <= max_row; ++row) {
+        const size_t first = row * columns_;
+        result.insert(result.end(), items_.begin() + cell_starts_[first + min_column],
+                      items_.begin() + cell_starts_[first + max_column + 1]);
+    }
+
+    // Объект, занимающий несколько ячеек, встречается в каждой из них
+    std::sort(result.begin(), result.end());
+    result.erase(std::unique(result.begin(), result.end()), result.end());
+    return result;
+}
+
+bool GridIndex::GetCells(const Rect& rect, size_t& min_column, size_t& max_column,
+                         size_t& min_row, size_t& max_row) const {
+    if (columns_ == 0 || rect.max_x < bounds_.min_x || rect.min_x > bounds_.max_x ||
+        rect.max_y < bounds_.min_y || rect.min_y > bounds_.max_y) {
+        return false;
+    }
+
+    const auto to_cell = [](double value, double origin, double cell_size, size_t cell_count) -> size_t {
+        if (!(cell_size > 0)) {
+            return 0;
+        }
+        const double cell = std::floor((value - origin) / cell_size);
+        if (cell <= 0) {
+            return 0;
+        }
+        return std::min(static_cast<size_t>(cell), cell_count - 1);
+    };
+    min_column = to_cell(rect.min_x, bounds_.min_x, cell_width_, columns_);
+    max_column = to_cell(rect.max_x, bounds_.min_x, cell_width_, columns_);
+    min_row = to_cell(rect.min_y, bounds_.min_y, cell_height_, rows_);
+    max_row = to_cell(rect.max_y, bounds_.min_y, cell_height_, rows_);
+    return true;
+}
+
+template <typename Func>
+void GridIndex::ForEachCell(const Segment& segment, Func func) const {
+    // Отрезок обходится по вертикальным полосам столбцов: в каждой полосе он занимает
+    // строки между своими точками на границах полосы. Так перебираются только ячейки,
+    // через которые он проходит, а не весь охватывающий прямоугольник
+    const bool forward = segment.x0 <= segment.x1;
+    const double x0 = forward ? segment.x0 : segment.x1;
+    const double y0 = forward ? segment.y0 : segment.y1;
+    const double x1 = forward ? segment.x1 : segment.x0;
+    const double y1 = forward ? segment.y1 : segment.y0;
+    const double slope = x1 > x0 ? (y1 - y0) / (x1 - x0) : 0.0;
+
+    size_t min_column, max_column, min_row, max_row;
+    GetCells({x0, std::min(y0, y1), x1, std::max(y0, y1)}, min_column, max_column, min_row, max_row);
+    for (size_t column = min_column; column <= max_column; ++column) {
+        double strip_y0 = y0;
+        double strip_y1 = y1;
+        if (min_column != max_column) {
+            const double strip_x0 = std::max(x0, bounds_.min_x + cell_width_ * static_cast<double>(column));
+            const double strip_x1 = std::min(x1, bounds_.min_x + cell_width_ * static_cast<double>(column + 1));
+            strip_y0 = column == min_column ? y0 : y0 + (strip_x0 - x0) * slope;
+            strip_y1 = column == max_column ? y1 : y0 + (strip_x1 - x0) * slope;
+        }
+        // Погрешность вычисления не должна выводить точки за пределы сетки
+        strip_y0 = std::clamp(strip_y0, bounds_.min_y, bounds_.max_y);
+        strip_y1 = std::clamp(strip_y1, bounds_.min_y, bounds_.max_y);
+        size_t strip_min_column, strip_max_column, strip_min_row, strip_max_row;
+        GetCells({x0, std::min(strip_y0, strip_y1), x0, std::max(strip_y0, strip_y1)},
+                 strip_min_column, strip_max_column, strip_min_row, strip_max_row);
+        for (size_t row = strip_min_row; row <= strip_max_row; ++row) {
+            func(row * columns_ + column);
+        }
+    }
+}
+
+} // namespace map_renderer
@@ -0,0 +1,69 @@
+#pragma once
+
+/*
+ * Пространственный индекс карты: равномерная сетка над охватывающим прямоугольником.
+ * Объекты - отрезки (точка - отрезок нулевой длины). Отрезок записывается только в ячейки,
+ * через которые проходит, поэтому запрос перебирает лишь ячейки области и не зависит
+ * от размера всей сети.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace map_renderer {
+
+// Прямоугольник со сторонами, параллельными осям
+struct Rect {
+    double min_x = 0;
+    double min_y = 0;
+    double max_x = 0;
+    double max_y = 0;
+
+    bool Contains(double x, double y) const {
+        return x >= min_x && x <= max_x && y >= min_y && y <= max_y;
+    }
+};
+
+struct Segment {
+    double x0 = 0;
+    double y0 = 0;
+    double x1 = 0;
+    double y1 = 0;
+};
+
+class GridIndex {
+public:
+    GridIndex() = default;
+
+    // segments[i] - объект i. Число ячеек примерно равно числу объектов
+    explicit GridIndex(const std::vector<Segment>& segments);
+
+    // Номера объектов из ячеек, пересекающих rect, по возрастанию и без повторов.
+    // Среди них могут быть объекты, которые сами rect не пересекают
+    std::vector<uint32_t> Query(const Rect& rect) const;
+
+    const Rect& GetBounds() const {
+        return bounds_;
+    }
+
+private:
+    // Ячейки, которые пересекает прямоугольник. Возвращает false, если он вне сетки
+    bool GetCells(const Rect& rect, size_t& min_column, size_t& max_column,
+                  size_t& min_row, size_t& max_row) const;
+
+    // Вызывает func(cell) для каждой ячейки, через которую проходит отрезок
+    template <typename Func>
+    void ForEachCell(const Segment& segment, Func func) const;
+
+    Rect bounds_;
+    size_t columns_ = 0;
+    size_t rows_ = 0;
+    double cell_width_ = 0;
+    double cell_height_ = 0;
+    // Объекты ячейки i - items_[cell_starts_[i]..cell_starts_[i + 1])
+    std::vector<uint32_t> cell_starts_;
+    std::vector<uint32_t> items_;
+};
+
+} // namespace map_renderer
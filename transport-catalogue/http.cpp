@@ -0,0 +1,236 @@
+#include "http.h"
+
+#ifdef DEBUG_PRINT
+#undef DEBUG_PRINT
+#endif
+#define DEBUG_PRINT(x) \
+    do                 \
+    {                  \
+    } while (0)
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+#include <optional>
+
+namespace server
+{
+
+    namespace
+    {
+        using namespace std::literals;
+
+        constexpr std::string_view CRLF = "\r\n"sv;
+        constexpr std::string_view HEAD_END = "\r\n\r\n"sv;
+
+        bool EqualsIgnoreCase(std::string_view lhs, std::string_view rhs)
+        {
+            return lhs.size() == rhs.size() &&
+                   std::equal(lhs.begin(), lhs.end(), rhs.begin(), [](char a, char b)
+                              { return std::tolower(static_cast<unsigned char>(a)) ==
+                                       std::tolower(static_cast<unsigned char>(b)); });
+        }
+
+        std::string_view Trim(std::string_view value)
+        {
+            const size_t begin = value.find_first_not_of(" \t"sv);
+            if (begin == std::string_view::npos)
+            {
+                return {};
+            }
+            const size_t end = value.find_last_not_of(" \t"sv);
+            return value.substr(begin, end - begin + 1);
+        }
+
+        // Перебирает элементы списка через запятую (например, значения заголовка Connection)
+        template <typename Func>
+        void ForEachToken(std::string_view value, Func func)
+        {
+            while (!value.empty())
+            {
+                const size_t comma = value.find(',');
+                func(Trim(value.substr(0, comma)));
+                if (comma == std::string_view::npos)
+                {
+                    break;
+                }
+                value.remove_prefix(comma + 1);
+            }
+        }
+
+        size_t ParseContentLength(std::string_view value)
+        {
+            size_t length = 0;
+            const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), length);
+            if (value.empty() || error != std::errc{} || end != value.data() + value.size())
+            {
+                throw HttpError(400, "Invalid Content-Length");
+            }
+            return length;
+        }
+
+    } // namespace
+
+    size_t FindHttpHeadEnd(std::string_view data, size_t from)
+    {
+        // Конец заголовка мог начаться в уже просмотренной части
+        from = from < HEAD_END.size() ? 0 : from - (HEAD_END.size() - 1);
+        const size_t pos = data.find(HEAD_END, from);
+        return pos == std::string_view::npos ? pos : pos + HEAD_END.size();
+    }
+
+    HttpRequest ParseHttpHead(std::string_view head)
+    {
+        HttpRequest request;
+        request.head_size = head.size();
+
+        // Строка запроса: METHOD SP TARGET SP HTTP/1.x
+        const size_t line_end = head.find(CRLF);
+        const std::string_view line = head.substr(0, line_end);
+        const size_t first_space = line.find(' ');
+        const size_t second_space = line.find(' ', first_space + 1);
+        if (first_space == std::string_view::npos || second_space == std::string_view::npos ||
+            line.find(' ', second_space + 1) != std::string_view::npos)
+        {
+            throw HttpError(400, "Malformed request line");
+        }
+        request.method = line.substr(0, first_space);
+        request.target = line.substr(first_space + 1, second_space - first_space - 1);
+        const std::string_view version = line.substr(second_space + 1);
+        if (version == "HTTP/1.1"sv)
+        {
+            request.keep_alive = true;
+        }
+        else if (version == "HTTP/1.0"sv)
+        {
+            request.keep_alive = false;
+        }
+        else
+        {
+            throw HttpError(505, "Unsupported HTTP version");
+        }
+        if (request.method.empty() || request.target.empty())
+        {
+            throw HttpError(400, "Malformed request line");
+        }
+
+        std::optional<size_t> content_length;
+        std::string_view fields = head.substr(line_end + CRLF.size());
+        while (!fields.empty())
+        {
+            const size_t end = fields.find(CRLF);
+            const std::string_view field = fields.substr(0, end);
+            fields.remove_prefix(end == std::string_view::npos ? fields.size() : end + CRLF.size());
+            if (field.empty())
+            {
+                break;
+            }
+
+            const size_t colon = field.find(':');
+            if (colon == std::string_view::npos || colon == 0)
+            {
+                throw HttpError(400, "Malformed header field");
+            }
+            const std::string_view name = field.substr(0, colon);
+            const std::string_view value = Trim(field.substr(colon + 1));
+
+            if (EqualsIgnoreCase(name, "Content-Length"sv))
+            {
+                const size_t length = ParseContentLength(value);
+                if (content_length && *content_length != length)
+                {
+                    throw HttpError(400, "Conflicting Content-Length");
+                }
+                content_length = length;
+            }
+            else if (EqualsIgnoreCase(name, "Transfer-Encoding"sv))
+            {
+                // Без Content-Length границу тела определить нельзя
+                throw HttpError(501, "Transfer-Encoding is not supported");
+            }
+            else if (EqualsIgnoreCase(name, "Connection"sv))
+            {
+                ForEachToken(value, [&request](std::string_view token)
+                             {
+                                 if (EqualsIgnoreCase(token, "close"sv))
+                                 {
+                                     request.keep_alive = false;
+                                 }
+                                 else if (EqualsIgnoreCase(token, "keep-alive"sv))
+                                 {
+                                     request.keep_alive = true;
+                                 } });
+            }
+            else if (EqualsIgnoreCase(name, "Expect"sv))
+            {
+                if (!EqualsIgnoreCase(value, "100-continue"sv))
+                {
+                    throw HttpError(417, "Unsupported expectation");
+                }
+                request.expect_continue = true;
+            }
+        }
+
+        request.content_length = content_length.value_or(0);
+        DEBUG_PRINT("HTTP " << request.method << " " << request.target << ", body " << request.content_length);
+        return request;
+    }
+
+    std::string_view GetHttpReason(int status)
+    {
+        switch (status)
+        {
+        case 100:
+            return "Continue"sv;
+        case 200:
+            return "OK"sv;
+        case 400:
+            return "Bad Request"sv;
+        case 404:
+            return "Not Found"sv;
+        case 405:
+            return "Method Not Allowed"sv;
+        case 413:
+            return "Payload Too Large"sv;
+        case 417:
+            return "Expectation Failed"sv;
+        case 431:
+            return "Request Header Fields Too Large"sv;
+        case 500:
+            return "Internal Server Error"sv;
+        case 501:
+            return "Not Implemented"sv;
+        case 505:
+            return "HTTP Version Not Supported"sv;
+        default:
+            return "Unknown"sv;
+        }
+    }
+
+    std::string FormatHttpResponse(int status, std::string_view body, bool keep_alive, std::string_view content_type)
+    {
+        const std::string length = std::to_string(body.size());
+        std::string response;
+        response.reserve(128 + body.size());
+        response += "HTTP/1.1 "sv;
+        response += std::to_string(status);
+        response += ' ';
+        response += GetHttpReason(status);
+        response += "\r\nContent-Type: "sv;
+        response += content_type;
+        response += "\r\nContent-Length: "sv;
+        response += length;
+        if (status == 405)
+        {
+            response += "\r\nAllow: POST"sv;
+        }
+        if (!keep_alive)
+        {
+            response += "\r\nConnection: close"sv;
+        }
+        response += HEAD_END;
+        response += body;
+        return response;
+    }
+
+} // namespace server
@@ -0,0 +1,60 @@
+#pragma once
+
+/*
+ * Минимальный разбор и формирование сообщений HTTP/1.1 для сервера запросов.
+ *
+ * Поддерживается ровно то, что нужно серверу: тело запроса задаётся Content-Length,
+ * соединение остаётся открытым (keep-alive) по правилам HTTP/1.1 и HTTP/1.0,
+ * запросы одного соединения могут идти подряд без ожидания ответов (pipelining).
+ * Разбор работает с представлениями строк во входном буфере и ничего не копирует.
+ */
+
+#include <cstddef>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace server
+{
+
+    // Ошибка запроса, на которую отвечают указанным кодом состояния и закрывают соединение
+    class HttpError : public std::runtime_error
+    {
+    public:
+        HttpError(int status, const std::string &message) : std::runtime_error(message), status_(status) {}
+
+        int GetStatus() const
+        {
+            return status_;
+        }
+
+    private:
+        int status_;
+    };
+
+    struct HttpRequest
+    {
+        std::string_view method;
+        std::string_view target;
+        // Размер заголовка вместе с завершающей пустой строкой
+        size_t head_size = 0;
+        size_t content_length = 0;
+        bool keep_alive = true;
+        bool expect_continue = false;
+    };
+
+    // Ищет конец заголовка запроса в начале data, продолжая поиск с from.
+    // Возвращает размер заголовка или std::string_view::npos, если он ещё не получен целиком
+    size_t FindHttpHeadEnd(std::string_view data, size_t from = 0);
+
+    // Разбирает заголовок запроса. Бросает HttpError, если запрос некорректен
+    // или использует неподдерживаемое кодирование тела
+    HttpRequest ParseHttpHead(std::string_view head);
+
+    std::string_view GetHttpReason(int status);
+
+    // Полный ответ: строка состояния, заголовки и тело
+    std::string FormatHttpResponse(int status, std::string_view body, bool keep_alive,
+                                   std::string_view content_type = "application/json");
+
+} // namespace server
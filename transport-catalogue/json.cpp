@@ -1,7 +1,11 @@
 #include "json.h"
 #include "json_builder.h"
 
+#include <array>
+#include <charconv>
 #include <iterator>
+#include <streambuf>
+#include <system_error>
 
 namespace json
 {
@@ -165,39 +169,90 @@ namespace json
             }
         }
 
+        // Буфер для текстового представления числа. Короткие числа (а это почти все
+        // координаты и расстояния) собираются на стеке без выделения динамической памяти
+        class NumberBuffer
+        {
+        public:
+            void Push(char c)
+            {
+                if (size_ < small_.size())
+                {
+                    small_[size_++] = c;
+                    return;
+                }
+                if (large_.empty())
+                {
+                    large_.assign(small_.data(), size_);
+                }
+                large_.push_back(c);
+                ++size_;
+            }
+
+            const char *Begin() const
+            {
+                return large_.empty() ? small_.data() : large_.data();
+            }
+
+            const char *End() const
+            {
+                return Begin() + size_;
+            }
+
+            std::string ToString() const
+            {
+                return std::string(Begin(), size_);
+            }
+
+        private:
+            std::array<char, 64> small_{};
+            std::string large_;
+            size_t size_ = 0;
+        };
+
         Node LoadNumber(std::istream &input)
         {
-            std::string parsed_num;
+            // Читаем напрямую из буфера потока, минуя проверки istream::peek/get на каждый символ
+            std::streambuf &buf = *input.rdbuf();
+            using Traits = std::streambuf::traits_type;
+
+            NumberBuffer parsed_num;
+
+            auto peek = [&buf]
+            {
+                return buf.sgetc();
+            };
 
             // Считывает в parsed_num очередной символ из input
-            auto read_char = [&parsed_num, &input]
+            auto read_char = [&parsed_num, &buf]
             {
-                parsed_num += static_cast<char>(input.get());
-                if (!input)
-                {
-                    throw ParsingError("Failed to read number from stream"s);
-                }
+                parsed_num.Push(Traits::to_char_type(buf.sbumpc()));
+            };
+
+            auto is_digit = [](int ch)
+            {
+                return ch >= '0' && ch <= '9';
             };
 
             // Считывает одну или более цифр в parsed_num из input
-            auto read_digits = [&input, read_char]
+            auto read_digits = [&peek, &read_char, &is_digit]
             {
-                if (!std::isdigit(input.peek()))
+                if (!is_digit(peek()))
                 {
                     throw ParsingError("A digit is expected"s);
                 }
-                while (std::isdigit(input.peek()))
+                while (is_digit(peek()))
                 {
                     read_char();
                 }
             };
 
-            if (input.peek() == '-')
+            if (peek() == '-')
             {
                 read_char();
             }
             // Парсим целую часть числа
-            if (input.peek() == '0')
+            if (peek() == '0')
             {
                 read_char();
                 // После 0 в JSON не могут идти другие цифры
@@ -209,7 +264,7 @@ namespace json
 
             bool is_int = true;
             // Парсим дробную часть числа
-            if (input.peek() == '.')
+            if (peek() == '.')
             {
                 read_char();
                 read_digits();
@@ -217,10 +272,10 @@ namespace json
             }
 
             // Парсим экспоненциальную часть числа
-            if (int ch = input.peek(); ch == 'e' || ch == 'E')
+            if (int ch = peek(); ch == 'e' || ch == 'E')
             {
                 read_char();
-                if (ch = input.peek(); ch == '+' || ch == '-')
+                if (ch = peek(); ch == '+' || ch == '-')
                 {
                     read_char();
                 }
@@ -228,27 +283,26 @@ namespace json
                 is_int = false;
             }
 
-            try
+            const char *first = parsed_num.Begin();
+            const char *last = parsed_num.End();
+
+            if (is_int)
             {
-                if (is_int)
+                // Сначала пробуем преобразовать строку в int. В случае неудачи,
+                // например, при переполнении, код ниже преобразует строку в double
+                int int_value = 0;
+                if (auto [ptr, ec] = std::from_chars(first, last, int_value); ec == std::errc{} && ptr == last)
                 {
-                    // Сначала пробуем преобразовать строку в int
-                    try
-                    {
-                        return std::stoi(parsed_num);
-                    }
-                    catch (...)
-                    {
-                        // В случае неудачи, например, при переполнении
-                        // код ниже попробует преобразовать строку в double
-                    }
+                    return Node{int_value};
                 }
-                return std::stod(parsed_num);
             }
-            catch (...)
+
+            double double_value = 0.0;
+            if (auto [ptr, ec] = std::from_chars(first, last, double_value); ec == std::errc{} && ptr == last)
             {
-                throw ParsingError("Failed to convert "s + parsed_num + " to number"s);
+                return Node{double_value};
             }
+            throw ParsingError("Failed to convert "s + parsed_num.ToString() + " to number"s);
         }
 
         Node LoadNode(std::istream &input)
@@ -289,20 +343,38 @@ namespace json
         struct PrintContext
         {
             std::ostream &out;
+            PrintOptions options;
             int indent_step = 4;
             int indent = 0;
 
             void PrintIndent() const
             {
+                if (options.compact)
+                {
+                    return;
+                }
                 for (int i = 0; i < indent; ++i)
                 {
                     out.put(' ');
                 }
             }
 
+            void PrintLineBreak() const
+            {
+                if (!options.compact)
+                {
+                    out.put('\n');
+                }
+            }
+
+            void PrintKeySeparator() const
+            {
+                out << (options.compact ? ":"sv : ": "sv);
+            }
+
             PrintContext Indented() const
             {
-                return {out, indent_step, indent_step + indent};
+                return {out, options, indent_step, indent_step + indent};
             }
         };
 
@@ -314,40 +386,22 @@ namespace json
             ctx.out << value;
         }
 
-        void PrintString(const std::string &value, std::ostream &out)
+        template <>
+        void PrintValue<std::string>(const std::string &value, const PrintContext &ctx)
         {
-            out.put('"');
-            for (const char c : value)
-            {
-                switch (c)
-                {
-                case '\r':
-                    out << "\\r"sv;
-                    break;
-                case '\n':
-                    out << "\\n"sv;
-                    break;
-                case '\t':
-                    out << "\\t"sv;
-                    break;
-                case '"':
-                    // Символы " и \ выводятся как \" или \\, соответственно
-                    [[fallthrough]];
-                case '\\':
-                    out.put('\\');
-                    [[fallthrough]];
-                default:
-                    out.put(c);
-                    break;
-                }
-            }
-            out.put('"');
+            PrintString(value, ctx.out);
         }
 
         template <>
-        void PrintValue<std::string>(const std::string &value, const PrintContext &ctx)
+        void PrintValue<int>(const int &value, const PrintContext &ctx)
         {
-            PrintString(value, ctx.out);
+            PrintNumber(value, ctx.out);
+        }
+
+        template <>
+        void PrintValue<double>(const double &value, const PrintContext &ctx)
+        {
+            PrintNumber(value, ctx.out);
         }
 
         template <>
@@ -370,7 +424,8 @@ namespace json
         void PrintValue<Array>(const Array &nodes, const PrintContext &ctx)
         {
             std::ostream &out = ctx.out;
-            out << "[\n"sv;
+            out.put('[');
+            ctx.PrintLineBreak();
             bool first = true;
             auto inner_ctx = ctx.Indented();
             for (const Node &node : nodes)
@@ -381,12 +436,13 @@ namespace json
                 }
                 else
                 {
-                    out << ",\n"sv;
+                    out.put(',');
+                    ctx.PrintLineBreak();
                 }
                 inner_ctx.PrintIndent();
                 PrintNode(node, inner_ctx);
             }
-            out.put('\n');
+            ctx.PrintLineBreak();
             ctx.PrintIndent();
             out.put(']');
         }
@@ -395,7 +451,8 @@ namespace json
         void PrintValue<Dict>(const Dict &nodes, const PrintContext &ctx)
         {
             std::ostream &out = ctx.out;
-            out << "{\n"sv;
+            out.put('{');
+            ctx.PrintLineBreak();
             bool first = true;
             auto inner_ctx = ctx.Indented();
             for (const auto &[key, node] : nodes)
@@ -406,14 +463,15 @@ namespace json
                 }
                 else
                 {
-                    out << ",\n"sv;
+                    out.put(',');
+                    ctx.PrintLineBreak();
                 }
                 inner_ctx.PrintIndent();
                 PrintString(key, ctx.out);
-                out << ": "sv;
+                ctx.PrintKeySeparator();
                 PrintNode(node, inner_ctx);
             }
-            out.put('\n');
+            ctx.PrintLineBreak();
             ctx.PrintIndent();
             out.put('}');
         }
@@ -435,9 +493,144 @@ namespace json
         return Document{LoadNode(input)};
     }
 
+    Document Load(std::string_view text)
+    {
+        // Буфер потока, читающий прямо из переданной строки
+        class ViewStreamBuf : public std::streambuf
+        {
+        public:
+            explicit ViewStreamBuf(std::string_view text)
+            {
+                char *begin = const_cast<char *>(text.data());
+                setg(begin, begin, begin + text.size());
+            }
+        };
+
+        ViewStreamBuf buf(text);
+        std::istream input(&buf);
+        return Load(input);
+    }
+
     void Print(const Document &doc, std::ostream &output)
     {
-        PrintNode(doc.GetRoot(), PrintContext{output});
+        Print(doc, output, PrintOptions{});
+    }
+
+    void Print(const Document &doc, std::ostream &output, const PrintOptions &options)
+    {
+        PrintNode(doc.GetRoot(), PrintContext{output, options});
+    }
+
+    void PrintString(std::string_view value, std::ostream &output)
+    {
+        output.put('"');
+        // Участки без спецсимволов выводятся целиком, а не посимвольно
+        size_t run_start = 0;
+        for (size_t i = 0; i < value.size(); ++i)
+        {
+            std::string_view escaped;
+            switch (value[i])
+            {
+            case '\r':
+                escaped = "\\r"sv;
+                break;
+            case '\n':
+                escaped = "\\n"sv;
+                break;
+            case '\t':
+                escaped = "\\t"sv;
+                break;
+            case '"':
+                // Символы " и \ выводятся как \" или \\, соответственно
+                escaped = "\\\""sv;
+                break;
+            case '\\':
+                escaped = "\\\\"sv;
+                break;
+            default:
+                continue;
+            }
+            output.write(value.data() + run_start, i - run_start);
+            output.write(escaped.data(), escaped.size());
+            run_start = i + 1;
+        }
+        output.write(value.data() + run_start, value.size() - run_start);
+        output.put('"');
+    }
+
+    void Print(const Node &node, std::ostream &output, const PrintOptions &options, int indent)
+    {
+        PrintNode(node, PrintContext{output, options, 4, indent});
+    }
+
+    ArrayWriter::ArrayWriter(std::ostream &output, const PrintOptions &options)
+        : output_(output), options_(options)
+    {
+    }
+
+    void ArrayWriter::Start()
+    {
+        if (!started_)
+        {
+            output_.put('[');
+            PrintContext{output_, options_}.PrintLineBreak();
+            started_ = true;
+        }
+    }
+
+    void ArrayWriter::Write(const Node &node)
+    {
+        Print(node, BeginElement(), options_, GetElementIndent());
+    }
+
+    std::ostream &ArrayWriter::BeginElement()
+    {
+        if (finished_)
+        {
+            throw std::logic_error("Write called after Finish"s);
+        }
+        Start();
+        const PrintContext ctx{output_, options_};
+        if (!empty_)
+        {
+            output_.put(',');
+            ctx.PrintLineBreak();
+        }
+        empty_ = false;
+
+        ctx.Indented().PrintIndent();
+        return output_;
+    }
+
+    int ArrayWriter::GetElementIndent() const
+    {
+        return PrintContext{output_, options_}.Indented().indent;
+    }
+
+    void ArrayWriter::Finish()
+    {
+        if (finished_)
+        {
+            return;
+        }
+        Start();
+        PrintContext{output_, options_}.PrintLineBreak();
+        output_.put(']');
+        finished_ = true;
+    }
+
+    void PrintNumber(int value, std::ostream &output)
+    {
+        std::array<char, 16> buffer;
+        auto [ptr, ec] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+        output.write(buffer.data(), ptr - buffer.data());
+    }
+
+    void PrintNumber(double value, std::ostream &output)
+    {
+        std::array<char, 32> buffer;
+        auto [ptr, ec] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+        output.write(buffer.data(), ptr - buffer.data());
     }
 
     // Реализация вспомогательных функций
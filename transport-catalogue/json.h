@@ -2,7 +2,9 @@
 
 #include <iostream>
 #include <map>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
@@ -169,6 +171,12 @@ namespace json
             return root_;
         }
 
+        // Передаёт корень документа вызывающему коду без копирования дерева
+        Node ReleaseRoot()
+        {
+            return std::move(root_);
+        }
+
     private:
         Node root_;
     };
@@ -185,7 +193,64 @@ namespace json
 
     Document Load(std::istream &input);
 
+    // Разбор JSON-значения из буфера в памяти без копирования текста
+    Document Load(std::string_view text);
+
+    // Настройки вывода JSON
+    struct PrintOptions
+    {
+        // Вывод в одну строку без переводов строк и отступов
+        bool compact = false;
+    };
+
     void Print(const Document &doc, std::ostream &output);
+    void Print(const Document &doc, std::ostream &output, const PrintOptions &options);
+
+    // Выводит узел так, как если бы он находился внутри документа на уровне отступа indent
+    void Print(const Node &node, std::ostream &output, const PrintOptions &options, int indent);
+
+    // Потоковая запись JSON-массива: каждый элемент выводится сразу после поступления,
+    // поэтому объём памяти не зависит от числа элементов. Формат вывода совпадает с Print
+    class ArrayWriter
+    {
+    public:
+        explicit ArrayWriter(std::ostream &output, const PrintOptions &options = {});
+
+        ArrayWriter(const ArrayWriter &) = delete;
+        ArrayWriter &operator=(const ArrayWriter &) = delete;
+
+        // Выводит очередной элемент массива
+        void Write(const Node &node);
+
+        // Готовит вывод очередного элемента, который вызывающий код запишет в возвращённый
+        // поток сам (например, через json::StreamBuilder) с отступом GetElementIndent()
+        std::ostream &BeginElement();
+        int GetElementIndent() const;
+        const PrintOptions &GetOptions() const
+        {
+            return options_;
+        }
+
+        // Завершает массив. Повторные вызовы ничего не делают
+        void Finish();
+
+    private:
+        void Start();
+
+        std::ostream &output_;
+        PrintOptions options_;
+        bool started_ = false;
+        bool finished_ = false;
+        bool empty_ = true;
+    };
+
+    // Вывод строки в кавычках с экранированием спецсимволов
+    void PrintString(std::string_view value, std::ostream &output);
+
+    // Вывод чисел без участия форматирования std::ostream
+    void PrintNumber(int value, std::ostream &output);
+    // Вещественное число выводится в кратчайшем виде, однозначно восстанавливаемом при чтении
+    void PrintNumber(double value, std::ostream &output);
 
     // Вспомогательные функции для работы с JSON
     std::string GetStringValue(const Dict &dict, const std::string &field_name);
@@ -343,3 +343,356 @@ namespace json
     }
 
 } // namespace json
+
+namespace json
+{
+
+    using namespace std::literals;
+
+    // Реализация методов контекстов StreamBuilder
+    StreamBuilder::KeyContext StreamBuilder::DictContext::Key(std::string_view key)
+    {
+        builder_.Key(key);
+        return KeyContext(builder_);
+    }
+
+    StreamBuilder &StreamBuilder::DictContext::EndDict()
+    {
+        return builder_.EndDict();
+    }
+
+    StreamBuilder::ValueContext StreamBuilder::KeyContext::Value(const json::Node &value)
+    {
+        builder_.Value(value);
+        return ValueContext(builder_);
+    }
+
+    StreamBuilder::ValueContext StreamBuilder::KeyContext::Value(std::string_view value)
+    {
+        builder_.Value(value);
+        return ValueContext(builder_);
+    }
+
+    StreamBuilder::ValueContext StreamBuilder::KeyContext::RawValue(std::string_view json)
+    {
+        builder_.RawValue(json);
+        return ValueContext(builder_);
+    }
+
+    StreamBuilder::ValueContext StreamBuilder::KeyContext::Value(const std::string &value)
+    {
+        return Value(std::string_view(value));
+    }
+
+    StreamBuilder::ValueContext StreamBuilder::KeyContext::Value(const char *value)
+    {
+        return Value(std::string_view(value));
+    }
+
+    StreamBuilder::ValueContext StreamBuilder::KeyContext::Value(int value)
+    {
+        builder_.Value(value);
+        return ValueContext(builder_);
+    }
+
+    StreamBuilder::ValueContext StreamBuilder::KeyContext::Value(double value)
+    {
+        builder_.Value(value);
+        return ValueContext(builder_);
+    }
+
+    StreamBuilder::ValueContext StreamBuilder::KeyContext::Value(bool value)
+    {
+        builder_.Value(value);
+        return ValueContext(builder_);
+    }
+
+    StreamBuilder::DictContext StreamBuilder::KeyContext::StartDict()
+    {
+        return builder_.StartDict();
+    }
+
+    StreamBuilder::ArrayContext StreamBuilder::KeyContext::StartArray()
+    {
+        return builder_.StartArray();
+    }
+
+    StreamBuilder::KeyContext StreamBuilder::ValueContext::Key(std::string_view key)
+    {
+        builder_.Key(key);
+        return KeyContext(builder_);
+    }
+
+    StreamBuilder &StreamBuilder::ValueContext::EndDict()
+    {
+        return builder_.EndDict();
+    }
+
+    StreamBuilder::ArrayContext &StreamBuilder::ArrayContext::Value(const json::Node &value)
+    {
+        builder_.Value(value);
+        return *this;
+    }
+
+    StreamBuilder::ArrayContext &StreamBuilder::ArrayContext::Value(std::string_view value)
+    {
+        builder_.Value(value);
+        return *this;
+    }
+
+    StreamBuilder::ArrayContext &StreamBuilder::ArrayContext::RawValue(std::string_view json)
+    {
+        builder_.RawValue(json);
+        return *this;
+    }
+
+    StreamBuilder::ArrayContext &StreamBuilder::ArrayContext::Value(const std::string &value)
+    {
+        return Value(std::string_view(value));
+    }
+
+    StreamBuilder::ArrayContext &StreamBuilder::ArrayContext::Value(const char *value)
+    {
+        return Value(std::string_view(value));
+    }
+
+    StreamBuilder::ArrayContext &StreamBuilder::ArrayContext::Value(int value)
+    {
+        builder_.Value(value);
+        return *this;
+    }
+
+    StreamBuilder::ArrayContext &StreamBuilder::ArrayContext::Value(double value)
+    {
+        builder_.Value(value);
+        return *this;
+    }
+
+    StreamBuilder::ArrayContext &StreamBuilder::ArrayContext::Value(bool value)
+    {
+        builder_.Value(value);
+        return *this;
+    }
+
+    StreamBuilder::DictContext StreamBuilder::ArrayContext::StartDict()
+    {
+        return builder_.StartDict();
+    }
+
+    StreamBuilder::ArrayContext StreamBuilder::ArrayContext::StartArray()
+    {
+        return builder_.StartArray();
+    }
+
+    StreamBuilder &StreamBuilder::ArrayContext::EndArray()
+    {
+        return builder_.EndArray();
+    }
+
+    // Реализация методов StreamBuilder
+    StreamBuilder::StreamBuilder(std::ostream &output, const PrintOptions &options, int indent)
+        : output_(output), options_(options), indent_(indent)
+    {
+    }
+
+    void StreamBuilder::PrintLineBreak() const
+    {
+        if (!options_.compact)
+        {
+            output_.put('\n');
+        }
+    }
+
+    void StreamBuilder::PrintIndent(int indent) const
+    {
+        if (options_.compact)
+        {
+            return;
+        }
+        for (int i = 0; i < indent; ++i)
+        {
+            output_.put(' ');
+        }
+    }
+
+    int StreamBuilder::ElementIndent() const
+    {
+        return indent_ + static_cast<int>(depth_) * 4;
+    }
+
+    void StreamBuilder::BeginValue(const char *operation)
+    {
+        if (state_ == BuilderState::ARRAY_EXPECTING_VALUE)
+        {
+            Frame &top = stack_[depth_ - 1];
+            if (!top.empty)
+            {
+                output_.put(',');
+            }
+            top.empty = false;
+            PrintLineBreak();
+            PrintIndent(ElementIndent());
+        }
+        else if (state_ != BuilderState::EMPTY && state_ != BuilderState::DICT_EXPECTING_VALUE)
+        {
+            throw std::logic_error(operation + " called in wrong state"s);
+        }
+    }
+
+    void StreamBuilder::EndValue()
+    {
+        if (depth_ == 0)
+        {
+            state_ = BuilderState::READY_TO_BUILD;
+        }
+        else if (stack_[depth_ - 1].is_dict)
+        {
+            state_ = BuilderState::DICT_EXPECTING_KEY;
+        }
+        else
+        {
+            state_ = BuilderState::ARRAY_EXPECTING_VALUE;
+        }
+    }
+
+    void StreamBuilder::OpenContainer(char bracket, bool is_dict, const char *operation)
+    {
+        BeginValue(operation);
+        if (depth_ == MAX_DEPTH)
+        {
+            throw std::logic_error(operation + " exceeds maximum nesting depth"s);
+        }
+        output_.put(bracket);
+        stack_[depth_++] = Frame{is_dict, true};
+        state_ = is_dict ? BuilderState::DICT_EXPECTING_KEY : BuilderState::ARRAY_EXPECTING_VALUE;
+    }
+
+    void StreamBuilder::CloseContainer(char bracket, BuilderState expected, const char *operation)
+    {
+        if (state_ != expected || depth_ == 0)
+        {
+            throw std::logic_error(operation + " called in wrong state"s);
+        }
+        if (stack_[depth_ - 1].empty)
+        {
+            // Пустой контейнер выводится так же, как в json::Print
+            PrintLineBreak();
+        }
+        --depth_;
+        PrintLineBreak();
+        PrintIndent(ElementIndent());
+        output_.put(bracket);
+        EndValue();
+    }
+
+    StreamBuilder::DictContext StreamBuilder::StartDict()
+    {
+        OpenContainer('{', true, "StartDict");
+        return DictContext(*this);
+    }
+
+    StreamBuilder::ArrayContext StreamBuilder::StartArray()
+    {
+        OpenContainer('[', false, "StartArray");
+        return ArrayContext(*this);
+    }
+
+    StreamBuilder &StreamBuilder::Value(const json::Node &value)
+    {
+        BeginValue("Value");
+        Print(value, output_, options_, ElementIndent());
+        EndValue();
+        return *this;
+    }
+
+    StreamBuilder &StreamBuilder::Value(std::string_view value)
+    {
+        BeginValue("Value");
+        PrintString(value, output_);
+        EndValue();
+        return *this;
+    }
+
+    StreamBuilder &StreamBuilder::Value(const std::string &value)
+    {
+        return Value(std::string_view(value));
+    }
+
+    StreamBuilder &StreamBuilder::Value(const char *value)
+    {
+        return Value(std::string_view(value));
+    }
+
+    StreamBuilder &StreamBuilder::Value(int value)
+    {
+        BeginValue("Value");
+        PrintNumber(value, output_);
+        EndValue();
+        return *this;
+    }
+
+    StreamBuilder &StreamBuilder::Value(double value)
+    {
+        BeginValue("Value");
+        PrintNumber(value, output_);
+        EndValue();
+        return *this;
+    }
+
+    StreamBuilder &StreamBuilder::Value(bool value)
+    {
+        BeginValue("Value");
+        output_ << (value ? "true"sv : "false"sv);
+        EndValue();
+        return *this;
+    }
+
+    StreamBuilder &StreamBuilder::RawValue(std::string_view json)
+    {
+        BeginValue("RawValue");
+        output_ << json;
+        EndValue();
+        return *this;
+    }
+
+    StreamBuilder &StreamBuilder::Key(std::string_view key)
+    {
+        if (state_ != BuilderState::DICT_EXPECTING_KEY)
+        {
+            throw std::logic_error("Key called in wrong state"s);
+        }
+        Frame &top = stack_[depth_ - 1];
+        if (!top.empty)
+        {
+            output_.put(',');
+        }
+        top.empty = false;
+        PrintLineBreak();
+        PrintIndent(ElementIndent());
+        PrintString(key, output_);
+        output_ << (options_.compact ? ":"sv : ": "sv);
+        state_ = BuilderState::DICT_EXPECTING_VALUE;
+        return *this;
+    }
+
+    StreamBuilder &StreamBuilder::EndDict()
+    {
+        CloseContainer('}', BuilderState::DICT_EXPECTING_KEY, "EndDict");
+        return *this;
+    }
+
+    StreamBuilder &StreamBuilder::EndArray()
+    {
+        CloseContainer(']', BuilderState::ARRAY_EXPECTING_VALUE, "EndArray");
+        return *this;
+    }
+
+    void StreamBuilder::Finish() const
+    {
+        if (state_ != BuilderState::READY_TO_BUILD)
+        {
+            throw std::logic_error("Finish called in wrong state"s);
+        }
+    }
+
+} // namespace json
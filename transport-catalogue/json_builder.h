@@ -1,8 +1,11 @@
 #pragma once
 
 #include "json.h"
+#include <array>
+#include <ostream>
 #include <stdexcept>
 #include <string>
+#include <string_view>
 
 namespace json
 {
@@ -121,4 +124,137 @@ namespace json
         void AddNode(json::Node node);
     };
 
+    // Билдер с тем же набором контекстов, что и Builder, но без построения дерева json::Node:
+    // каждый вызов сразу сериализуется в поток в формате json::Print.
+    // Недопустимые последовательности вызовов так же не компилируются
+    class StreamBuilder
+    {
+    public:
+        // indent - уровень отступа, на котором находится записываемое значение
+        explicit StreamBuilder(std::ostream &output, const PrintOptions &options = {}, int indent = 0);
+
+        // Forward declarations
+        class BaseContext;
+        class DictContext;
+        class KeyContext;
+        class ValueContext;
+        class ArrayContext;
+
+        // Базовый класс для всех контекстов
+        class BaseContext
+        {
+        protected:
+            explicit BaseContext(StreamBuilder &builder) : builder_(builder) {}
+            StreamBuilder &builder_;
+        };
+
+        // Контекст для словаря - можно только добавлять ключи и завершать словарь
+        class DictContext : public BaseContext
+        {
+        public:
+            explicit DictContext(StreamBuilder &builder) : BaseContext(builder) {}
+
+            KeyContext Key(std::string_view key);
+            StreamBuilder &EndDict();
+        };
+
+        // Контекст для ключа - можно только добавлять значение
+        class KeyContext : public BaseContext
+        {
+        public:
+            explicit KeyContext(StreamBuilder &builder) : BaseContext(builder) {}
+
+            ValueContext Value(const json::Node &value);
+            ValueContext Value(std::string_view value);
+            ValueContext Value(const std::string &value);
+            ValueContext Value(const char *value);
+            ValueContext Value(int value);
+            ValueContext Value(double value);
+            ValueContext Value(bool value);
+            ValueContext RawValue(std::string_view json);
+            DictContext StartDict();
+            ArrayContext StartArray();
+        };
+
+        // Контекст для значения - после Value можно только Key или EndDict
+        class ValueContext : public BaseContext
+        {
+        public:
+            explicit ValueContext(StreamBuilder &builder) : BaseContext(builder) {}
+
+            KeyContext Key(std::string_view key);
+            StreamBuilder &EndDict();
+        };
+
+        // Контекст для массива - можно добавлять значения и завершать массив
+        class ArrayContext : public BaseContext
+        {
+        public:
+            explicit ArrayContext(StreamBuilder &builder) : BaseContext(builder) {}
+
+            ArrayContext &Value(const json::Node &value);
+            ArrayContext &Value(std::string_view value);
+            ArrayContext &Value(const std::string &value);
+            ArrayContext &Value(const char *value);
+            ArrayContext &Value(int value);
+            ArrayContext &Value(double value);
+            ArrayContext &Value(bool value);
+            ArrayContext &RawValue(std::string_view json);
+            DictContext StartDict();
+            ArrayContext StartArray();
+            StreamBuilder &EndArray();
+        };
+
+        // Методы для начала построения - возвращают контексты
+        DictContext StartDict();
+        ArrayContext StartArray();
+
+        // Методы для простых значений
+        StreamBuilder &Value(const json::Node &value);
+        StreamBuilder &Value(std::string_view value);
+        StreamBuilder &Value(const std::string &value);
+        StreamBuilder &Value(const char *value);
+        StreamBuilder &Value(int value);
+        StreamBuilder &Value(double value);
+        StreamBuilder &Value(bool value);
+
+        // Записывает уже сериализованное значение как есть, например строку, экранированную
+        // заранее. Значение должно быть корректным JSON без переводов строк
+        StreamBuilder &RawValue(std::string_view json);
+
+        // Внутренние методы для контекстов
+        StreamBuilder &Key(std::string_view key);
+        StreamBuilder &EndDict();
+        StreamBuilder &EndArray();
+
+        // Проверяет, что значение записано целиком (аналог Builder::Build)
+        void Finish() const;
+
+    private:
+        // Максимальная глубина вложенности. Стек хранится внутри билдера,
+        // чтобы запись ответа не требовала выделения памяти
+        static constexpr size_t MAX_DEPTH = 64;
+
+        struct Frame
+        {
+            bool is_dict = false;
+            bool empty = true;
+        };
+
+        void BeginValue(const char *operation);
+        void EndValue();
+        void OpenContainer(char bracket, bool is_dict, const char *operation);
+        void CloseContainer(char bracket, BuilderState expected, const char *operation);
+        void PrintLineBreak() const;
+        void PrintIndent(int indent) const;
+        int ElementIndent() const;
+
+        std::ostream &output_;
+        PrintOptions options_;
+        int indent_;
+        std::array<Frame, MAX_DEPTH> stack_{};
+        size_t depth_ = 0;
+        BuilderState state_ = BuilderState::EMPTY;
+    };
+
 } // namespace json
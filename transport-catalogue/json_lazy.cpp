@@ -0,0 +1,296 @@
+#include "json_lazy.h"
+
+#ifdef DEBUG_PRINT
+#undef DEBUG_PRINT
+#endif
+#define DEBUG_PRINT(x) \
+    do                 \
+    {                  \
+    } while (0)
+
+#include "parallel.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+
+namespace json
+{
+
+    namespace
+    {
+        using namespace std::literals;
+
+        bool IsSpace(char c)
+        {
+            return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+        }
+
+        const char *SkipSpaces(const char *pos, const char *end)
+        {
+            while (pos != end && IsSpace(*pos))
+            {
+                ++pos;
+            }
+            return pos;
+        }
+
+        // Минимальный размер массива, при котором имеет смысл разбирать его в нескольких потоках
+        constexpr size_t MIN_ELEMENTS_PER_THREAD = 256;
+
+        // pos указывает на открывающую кавычку. Возвращает позицию после закрывающей
+        const char *SkipString(const char *pos, const char *end)
+        {
+            const char *search = pos + 1;
+            while (search < end)
+            {
+                // Ищем кавычку через memchr, а не посимвольно
+                const char *quote = static_cast<const char *>(std::memchr(search, '"', end - search));
+                if (!quote)
+                {
+                    break;
+                }
+                // Кавычка экранирована, если перед ней нечётное число обратных слэшей
+                size_t backslashes = 0;
+                for (const char *p = quote - 1; p > pos && *p == '\\'; --p)
+                {
+                    ++backslashes;
+                }
+                if (backslashes % 2 == 0)
+                {
+                    return quote + 1;
+                }
+                search = quote + 1;
+            }
+            throw ParsingError("String parsing error"s);
+        }
+
+        // Структурный проход: находит конец значения, начинающегося в pos,
+        // учитывая только кавычки и скобки
+        const char *SkipValue(const char *pos, const char *end)
+        {
+            if (pos == end)
+            {
+                throw ParsingError("Unexpected EOF"s);
+            }
+
+            if (*pos == '"')
+            {
+                return SkipString(pos, end);
+            }
+
+            if (*pos == '{' || *pos == '[')
+            {
+                int depth = 0;
+                while (pos != end)
+                {
+                    switch (*pos)
+                    {
+                    case '"':
+                        pos = SkipString(pos, end);
+                        continue;
+                    case '{':
+                    case '[':
+                        ++depth;
+                        break;
+                    case '}':
+                    case ']':
+                        if (--depth == 0)
+                        {
+                            return pos + 1;
+                        }
+                        break;
+                    default:
+                        break;
+                    }
+                    ++pos;
+                }
+                throw ParsingError("Unexpected EOF"s);
+            }
+
+            // Число или литерал продолжается до ближайшего разделителя
+            const char *value_end = pos;
+            while (value_end != end && !IsSpace(*value_end) && *value_end != ',' && *value_end != ']' && *value_end != '}')
+            {
+                ++value_end;
+            }
+            if (value_end == pos)
+            {
+                throw ParsingError("Unexpected character '"s + *pos + "'"s);
+            }
+            return value_end;
+        }
+
+        // Сравнивает ключ из текста (без кавычек, возможно с экранированием) с искомым
+        bool KeyEquals(std::string_view raw_key, std::string_view key)
+        {
+            if (raw_key.find('\\') == std::string_view::npos)
+            {
+                return raw_key == key;
+            }
+            const char *begin = raw_key.data() - 1;
+            return Load(std::string_view(begin, raw_key.size() + 2)).GetRoot().AsString() == key;
+        }
+
+    } // namespace
+
+    std::optional<LazyNode> LazyNode::Find(std::string_view key) const
+    {
+        if (!IsDict())
+        {
+            throw std::logic_error("Not a dict"s);
+        }
+
+        const char *pos = text_.data() + 1;
+        const char *end = text_.data() + text_.size();
+        while (true)
+        {
+            pos = SkipSpaces(pos, end);
+            if (pos == end)
+            {
+                throw ParsingError("Dictionary parsing error"s);
+            }
+            if (*pos == '}')
+            {
+                return std::nullopt;
+            }
+            if (*pos == ',')
+            {
+                ++pos;
+                continue;
+            }
+            if (*pos != '"')
+            {
+                throw ParsingError(R"(',' is expected but ')"s + *pos + "' has been found"s);
+            }
+
+            const char *key_end = SkipString(pos, end);
+            std::string_view raw_key(pos + 1, key_end - pos - 2);
+
+            pos = SkipSpaces(key_end, end);
+            if (pos == end || *pos != ':')
+            {
+                throw ParsingError("':' is expected after key '"s + std::string(raw_key) + "'"s);
+            }
+
+            const char *value_begin = SkipSpaces(pos + 1, end);
+            const char *value_end = SkipValue(value_begin, end);
+            if (KeyEquals(raw_key, key))
+            {
+                DEBUG_PRINT("Found key '" << key << "'");
+                return LazyNode(std::string_view(value_begin, value_end - value_begin));
+            }
+            pos = value_end;
+        }
+    }
+
+    void LazyNode::ForEachElement(const std::function<void(const LazyNode &)> &callback) const
+    {
+        if (!IsArray())
+        {
+            throw std::logic_error("Not an array"s);
+        }
+
+        const char *pos = text_.data() + 1;
+        const char *end = text_.data() + text_.size();
+        while (true)
+        {
+            pos = SkipSpaces(pos, end);
+            if (pos == end)
+            {
+                throw ParsingError("Array parsing error"s);
+            }
+            if (*pos == ']')
+            {
+                return;
+            }
+            if (*pos == ',')
+            {
+                ++pos;
+                continue;
+            }
+
+            const char *value_end = SkipValue(pos, end);
+            callback(LazyNode(std::string_view(pos, value_end - pos)));
+            pos = value_end;
+        }
+    }
+
+    std::vector<LazyNode> LazyNode::GetElements() const
+    {
+        std::vector<LazyNode> elements;
+        ForEachElement([&elements](const LazyNode &element)
+                       { elements.push_back(element); });
+        return elements;
+    }
+
+    Node LazyNode::Parse() const
+    {
+        return Load(text_).ReleaseRoot();
+    }
+
+    Node LazyNode::ParseParallel(size_t thread_count) const
+    {
+        if (!IsArray() || thread_count < 2)
+        {
+            return Parse();
+        }
+
+        std::vector<LazyNode> elements = GetElements();
+        if (elements.size() < 2 * MIN_ELEMENTS_PER_THREAD)
+        {
+            return Parse();
+        }
+        return Node(ParseElements(elements.data(), elements.size(), thread_count));
+    }
+
+    Array ParseElements(const LazyNode *elements, size_t count, size_t thread_count)
+    {
+        thread_count = std::min(thread_count, std::max<size_t>(1, count / MIN_ELEMENTS_PER_THREAD));
+
+        // Каждый поток разбирает свою часть в собственный массив
+        std::vector<Array> parts(thread_count);
+        auto parse_part = [elements, &parts](size_t part, size_t begin, size_t end)
+        {
+            Array &result = parts[part];
+            result.reserve(end - begin);
+            for (size_t i = begin; i < end; ++i)
+            {
+                result.push_back(elements[i].Parse());
+            }
+        };
+        const size_t part_count = parallel::ForEachChunk(count, thread_count, parse_part);
+        DEBUG_PRINT("Parsed " << count << " elements in " << part_count << " parts");
+
+        // Сшиваем части в исходном порядке
+        Array result;
+        result.reserve(count);
+        for (size_t part = 0; part < part_count; ++part)
+        {
+            std::move(parts[part].begin(), parts[part].end(), std::back_inserter(result));
+        }
+        return result;
+    }
+
+    LazyDocument::LazyDocument(std::string text)
+        : text_(std::move(text))
+    {
+        const char *begin = text_.data();
+        const char *end = begin + text_.size();
+        const char *value_begin = SkipSpaces(begin, end);
+        const char *value_end = SkipValue(value_begin, end);
+        root_ = LazyNode(std::string_view(value_begin, value_end - value_begin));
+    }
+
+    LazyDocument LoadLazy(std::istream &input)
+    {
+        std::string text;
+        char buffer[1 << 16];
+        while (input.read(buffer, sizeof(buffer)) || input.gcount() > 0)
+        {
+            text.append(buffer, static_cast<size_t>(input.gcount()));
+        }
+        return LazyDocument(std::move(text));
+    }
+
+} // namespace json
@@ -0,0 +1,96 @@
+#pragma once
+
+#include "json.h"
+
+#include <functional>
+#include <istream>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace json
+{
+
+    // Ленивое представление JSON-значения: хранит только границы значения в исходном тексте.
+    // Вложенные значения находятся быстрым структурным проходом (без построения узлов),
+    // а полноценный разбор выполняется только для тех поддеревьев, к которым обратились через Parse.
+    // Корректность текста проверяется только в разобранных поддеревьях.
+    class LazyNode
+    {
+    public:
+        LazyNode() = default;
+
+        // text должен содержать ровно одно JSON-значение без окружающих пробелов
+        explicit LazyNode(std::string_view text)
+            : text_(text)
+        {
+        }
+
+        bool IsNull() const { return Front() == 'n'; }
+        bool IsBool() const { return Front() == 't' || Front() == 'f'; }
+        bool IsString() const { return Front() == '"'; }
+        bool IsArray() const { return Front() == '['; }
+        bool IsDict() const { return Front() == '{'; }
+
+        // Исходный текст значения
+        std::string_view GetText() const
+        {
+            return text_;
+        }
+
+        // Ищет значение по ключу словаря, не разбирая значения остальных ключей
+        std::optional<LazyNode> Find(std::string_view key) const;
+
+        // Перебирает элементы массива по мере их нахождения в тексте:
+        // обработка первых элементов начинается до того, как найден конец массива
+        void ForEachElement(const std::function<void(const LazyNode &)> &callback) const;
+
+        // Находит границы всех элементов массива (без их разбора)
+        std::vector<LazyNode> GetElements() const;
+
+        // Полностью разбирает значение
+        Node Parse() const;
+
+        // Разбирает массив, распределяя элементы между thread_count потоками.
+        // Небольшие массивы и значения других типов разбираются в текущем потоке
+        Node ParseParallel(size_t thread_count) const;
+
+    private:
+        char Front() const
+        {
+            return text_.empty() ? '\0' : text_.front();
+        }
+
+        std::string_view text_;
+    };
+
+    // Документ, разбираемый по требованию. Владеет исходным текстом,
+    // поэтому полученные из него LazyNode действительны, пока жив документ
+    class LazyDocument
+    {
+    public:
+        explicit LazyDocument(std::string text);
+
+        LazyDocument(const LazyDocument &) = delete;
+        LazyDocument &operator=(const LazyDocument &) = delete;
+
+        const LazyNode &GetRoot() const
+        {
+            return root_;
+        }
+
+    private:
+        std::string text_;
+        LazyNode root_;
+    };
+
+    // Разбирает count элементов, начиная с elements, в thread_count потоках.
+    // Каждый поток собирает свою непрерывную часть в отдельный массив,
+    // затем части переносятся в результат в исходном порядке
+    Array ParseElements(const LazyNode *elements, size_t count, size_t thread_count);
+
+    // Читает поток до конца и индексирует только границы корневого значения
+    LazyDocument LoadLazy(std::istream &input);
+
+} // namespace json
@@ -1,4 +1,5 @@
 #include "json_reader.h"
+#include "parallel.h"
 
 #ifdef DEBUG_PRINT
 #undef DEBUG_PRINT
@@ -12,10 +13,49 @@
 #include <stdexcept>
 #include <iostream>
 #include <algorithm>
+#include <unordered_set>
 
 namespace json_reader
 {
 
+    namespace
+    {
+        // Действие базового запроса (поле "operation", по умолчанию "add")
+        enum class Operation
+        {
+            ADD,
+            UPDATE,
+            REMOVE
+        };
+
+        Operation GetOperation(const json::Dict &request_dict)
+        {
+            auto it = request_dict.find("operation");
+            if (it == request_dict.end())
+            {
+                return Operation::ADD;
+            }
+            if (!it->second.IsString())
+            {
+                throw json::ParsingError("operation must be a string");
+            }
+            const std::string &operation = it->second.AsString();
+            if (operation == "add")
+            {
+                return Operation::ADD;
+            }
+            if (operation == "update")
+            {
+                return Operation::UPDATE;
+            }
+            if (operation == "delete")
+            {
+                return Operation::REMOVE;
+            }
+            throw json::ParsingError("Unknown operation: " + operation);
+        }
+    } // namespace
+
     JsonReader::JsonReader(transport_catalogue::TransportCatalogue &catalogue)
         : catalogue_(catalogue)
     {
@@ -40,6 +80,44 @@ namespace json_reader
         return LoadDocument(input);
     }
 
+    json::LazyDocument JsonReader::LoadLazyDocument(std::istream &input)
+    {
+        return json::LoadLazy(input);
+    }
+
+    void JsonReader::ProcessDocument(const json::LazyDocument &document)
+    {
+        const json::LazyNode &root = document.GetRoot();
+
+        if (!root.IsDict())
+        {
+            throw json::ParsingError("Root node must be a dictionary");
+        }
+
+        // Базовые запросы нужны всегда, поэтому разбираем их сразу,
+        // на многоядерных машинах - параллельно
+        if (auto base_requests = root.Find("base_requests"))
+        {
+            ProcessBaseRequestsOptimized(base_requests->ParseParallel(parallel::DefaultThreadCount()));
+        }
+
+        // Настройки рендеринга нужны только запросам Map
+        deferred_render_settings_ = root.Find("render_settings");
+        DEBUG_PRINT("Render settings deferred: " << deferred_render_settings_.has_value());
+    }
+
+    bool JsonReader::ResolveRenderSettings()
+    {
+        if (!deferred_render_settings_)
+        {
+            return false;
+        }
+        render_settings_ = ParseRenderSettings(deferred_render_settings_->Parse());
+        deferred_render_settings_.reset();
+        DEBUG_PRINT("Parsed deferred render settings successfully");
+        return true;
+    }
+
     void JsonReader::ProcessDocument(const json::Document &document)
     {
         const json::Node &root = document.GetRoot();
@@ -63,6 +141,7 @@ namespace json_reader
         if (render_settings_it != root_dict.end())
         {
             render_settings_ = ParseRenderSettings(render_settings_it->second);
+            deferred_render_settings_.reset();
             DEBUG_PRINT("Parsed render settings successfully");
         }
     }
@@ -76,22 +155,45 @@ namespace json_reader
 
         const json::Array &requests = base_requests.AsArray();
 
-        // Временные массивы для сбора данных
-        std::vector<std::pair<std::string, std::pair<double, double>>> stops;
-        std::vector<std::tuple<std::string, std::string, double>> distances;
-        std::vector<std::pair<std::string, std::vector<std::string>>> buses;
-        std::vector<bool> is_roundtrip; // для маршрутов
-
-        DEBUG_PRINT("Phase 1: Collecting data in single pass...");
-
-        // Один проход по всем запросам
+        // Все строки берутся представлениями из DOM, который живёт до конца загрузки,
+        // поэтому каждое имя копируется только один раз - в сам каталог
+        // Фаза 0: подсчёт размеров, чтобы выделить память под все коллекции заранее
+        size_t stop_count = 0;
+        size_t distance_count = 0;
         for (const json::Node &request : requests)
         {
             if (!request.IsDict())
             {
                 throw json::ParsingError("Request must be a dictionary");
             }
+            const json::Dict &request_dict = request.AsMap();
+            auto type_it = request_dict.find("type");
+            if (type_it != request_dict.end() && type_it->second.IsString() && type_it->second.AsString() == "Stop" &&
+                GetOperation(request_dict) == Operation::ADD)
+            {
+                ++stop_count;
+                auto distances_it = request_dict.find("road_distances");
+                if (distances_it != request_dict.end() && distances_it->second.IsDict())
+                {
+                    distance_count += distances_it->second.AsMap().size();
+                }
+            }
+        }
+
+        std::vector<transport_catalogue::StopInput> stops;
+        std::vector<transport_catalogue::DistanceInput> distances;
+        std::vector<transport_catalogue::RouteInput> buses;
+        // Изменения и удаления применяются после добавлений, в порядке следования
+        std::vector<const json::Dict *> changes;
+        stops.reserve(stop_count);
+        distances.reserve(distance_count);
+        buses.reserve(requests.size() - stop_count);
 
+        DEBUG_PRINT("Phase 1: Collecting data in single pass...");
+
+        // Один проход по всем запросам
+        for (const json::Node &request : requests)
+        {
             const json::Dict &request_dict = request.AsMap();
             auto type_it = request_dict.find("type");
 
@@ -100,15 +202,21 @@ namespace json_reader
                 throw json::ParsingError("Request must have 'type' field as string");
             }
 
-            std::string type = type_it->second.AsString();
+            if (GetOperation(request_dict) != Operation::ADD)
+            {
+                changes.push_back(&request_dict);
+                continue;
+            }
+
+            const std::string &type = type_it->second.AsString();
 
             if (type == "Stop")
             {
                 // Собираем данные об остановке
-                std::string stop_name = GetStringValue(request_dict, "name");
+                std::string_view stop_name = GetStringRef(request_dict, "name");
                 double latitude = GetDoubleValue(request_dict, "latitude");
                 double longitude = GetDoubleValue(request_dict, "longitude");
-                stops.emplace_back(stop_name, std::make_pair(latitude, longitude));
+                stops.push_back({stop_name, {latitude, longitude}});
                 DEBUG_PRINT("Collected stop: " << stop_name << " at (" << latitude << ", " << longitude << ")");
 
                 // Собираем расстояния для этой остановки
@@ -127,7 +235,7 @@ namespace json_reader
                         {
                             throw json::ParsingError("Distance must be a number");
                         }
-                        distances.emplace_back(stop_name, target_stop, distance_node.AsDouble());
+                        distances.push_back({stop_name, target_stop, distance_node.AsDouble()});
                         DEBUG_PRINT("Collected distance: " << stop_name << " -> " << target_stop << " = " << distance_node.AsDouble());
                     }
                 }
@@ -135,36 +243,8 @@ namespace json_reader
             else if (type == "Bus")
             {
                 // Собираем данные о маршруте
-                std::string bus_name = GetStringValue(request_dict, "name");
-                auto stops_it = request_dict.find("stops");
-                if (stops_it == request_dict.end() || !stops_it->second.IsArray())
-                {
-                    throw json::ParsingError("Bus stops must be an array");
-                }
-                const json::Array &stops_array = stops_it->second.AsArray();
-                std::vector<std::string> stop_names;
-                for (const json::Node &stop_node : stops_array)
-                {
-                    if (!stop_node.IsString())
-                    {
-                        throw json::ParsingError("Stop name must be a string");
-                    }
-                    stop_names.push_back(stop_node.AsString());
-                }
-                buses.emplace_back(bus_name, stop_names);
-                // Проверяем, является ли маршрут кольцевым
-                bool roundtrip = false;
-                auto roundtrip_it = request_dict.find("is_roundtrip");
-                if (roundtrip_it != request_dict.end())
-                {
-                    if (!roundtrip_it->second.IsBool())
-                    {
-                        throw json::ParsingError("is_roundtrip must be a boolean");
-                    }
-                    roundtrip = roundtrip_it->second.AsBool();
-                }
-                is_roundtrip.push_back(roundtrip);
-                DEBUG_PRINT("Collected bus route: " << bus_name << " with " << stop_names.size() << " stops, roundtrip: " << roundtrip);
+                buses.push_back(ParseBusRequest(request_dict));
+                DEBUG_PRINT("Collected bus route: " << buses.back().name << " with " << buses.back().stops.size() << " stops");
             }
             else
             {
@@ -172,6 +252,33 @@ namespace json_reader
             }
         }
 
+        // Изменения применяются после всех добавлений, поэтому, например, delete X и затем add X
+        // оставили бы X удалённым. Пакет, который добавляет и изменяет один объект, отклоняется
+        if (!changes.empty())
+        {
+            std::unordered_set<std::string_view> added_stops;
+            std::unordered_set<std::string_view> added_buses;
+            for (const auto &stop : stops)
+            {
+                added_stops.insert(stop.name);
+            }
+            for (const auto &bus : buses)
+            {
+                added_buses.insert(bus.name);
+            }
+            for (const json::Dict *change : changes)
+            {
+                const std::string &type = GetStringRef(*change, "type");
+                const std::string &name = GetStringRef(*change, "name");
+                if ((type == "Stop" && added_stops.count(name)) || (type == "Bus" && added_buses.count(name)))
+                {
+                    throw std::invalid_argument(type + " '" + name + "' is both added and changed in one batch");
+                }
+            }
+        }
+
+        catalogue_.Reserve(stops.size(), buses.size(), distances.size());
+
         // Фаза 2: Пакетное добавление данных в каталог
         DEBUG_PRINT("Phase 2: Bulk adding " << stops.size() << " stops...");
         catalogue_.AddStops(stops);
@@ -179,15 +286,148 @@ namespace json_reader
         DEBUG_PRINT("Phase 3: Bulk adding " << distances.size() << " distances...");
         catalogue_.AddDistances(distances);
 
+        const size_t thread_count = parallel::DefaultThreadCount();
+
         DEBUG_PRINT("Phase 4: Bulk adding " << buses.size() << " routes...");
-        // Добавляем маршруты с учетом is_roundtrip
-        for (size_t i = 0; i < buses.size(); ++i)
+        catalogue_.AddRoutes(buses, thread_count);
+
+        DEBUG_PRINT("Phase 5: Applying " << changes.size() << " updates and deletions...");
+        for (const json::Dict *change : changes)
         {
-            catalogue_.AddRoute(buses[i].first, buses[i].second, is_roundtrip[i]);
+            ApplyChange(*change);
         }
+
+        DEBUG_PRINT("Phase 6: Building indexes...");
+        catalogue_.Finalize(thread_count);
         DEBUG_PRINT("Optimized processing completed successfully!");
     }
 
+    transport_catalogue::RouteInput JsonReader::ParseBusRequest(const json::Dict &request_dict)
+    {
+        transport_catalogue::RouteInput bus;
+        bus.name = GetStringRef(request_dict, "name");
+        auto stops_it = request_dict.find("stops");
+        if (stops_it == request_dict.end() || !stops_it->second.IsArray())
+        {
+            throw json::ParsingError("Bus stops must be an array");
+        }
+        const json::Array &stops_array = stops_it->second.AsArray();
+        bus.stops.reserve(stops_array.size());
+        for (const json::Node &stop_node : stops_array)
+        {
+            if (!stop_node.IsString())
+            {
+                throw json::ParsingError("Stop name must be a string");
+            }
+            bus.stops.push_back(stop_node.AsString());
+        }
+        // Проверяем, является ли маршрут кольцевым
+        auto roundtrip_it = request_dict.find("is_roundtrip");
+        if (roundtrip_it != request_dict.end())
+        {
+            if (!roundtrip_it->second.IsBool())
+            {
+                throw json::ParsingError("is_roundtrip must be a boolean");
+            }
+            bus.is_roundtrip = roundtrip_it->second.AsBool();
+        }
+        return bus;
+    }
+
+    void JsonReader::ApplyChange(const json::Dict &request_dict)
+    {
+        const std::string &type = GetStringRef(request_dict, "type");
+        const std::string &name = GetStringRef(request_dict, "name");
+        const Operation operation = GetOperation(request_dict);
+        DEBUG_PRINT("Applying change to " << type << " '" << name << "'");
+
+        if (type == "Stop")
+        {
+            if (operation == Operation::REMOVE)
+            {
+                if (!catalogue_.RemoveStop(name))
+                {
+                    throw std::invalid_argument("Stop not found: " + name);
+                }
+                return;
+            }
+
+            const Stop *stop = catalogue_.GetStopByName(name);
+            if (!stop)
+            {
+                throw std::invalid_argument("Stop not found: " + name);
+            }
+            // Координаты меняются, только если заданы; незаданная остаётся прежней
+            const bool has_latitude = request_dict.count("latitude") != 0;
+            const bool has_longitude = request_dict.count("longitude") != 0;
+            if (has_latitude || has_longitude)
+            {
+                catalogue_.UpdateStop(name, {has_latitude ? GetDoubleValue(request_dict, "latitude") : stop->coordinates.lat,
+                                             has_longitude ? GetDoubleValue(request_dict, "longitude") : stop->coordinates.lng});
+            }
+            // Расстояние со значением null удаляется
+            auto distances_it = request_dict.find("road_distances");
+            if (distances_it != request_dict.end())
+            {
+                if (!distances_it->second.IsDict())
+                {
+                    throw json::ParsingError("road_distances must be a dictionary");
+                }
+                for (const auto &[target_stop, distance_node] : distances_it->second.AsMap())
+                {
+                    if (distance_node.IsNull())
+                    {
+                        catalogue_.RemoveDistance(name, target_stop);
+                    }
+                    else if (distance_node.IsDouble())
+                    {
+                        catalogue_.AddDistances(std::vector<transport_catalogue::DistanceInput>{{name, target_stop, distance_node.AsDouble()}});
+                    }
+                    else
+                    {
+                        throw json::ParsingError("Distance must be a number or null");
+                    }
+                }
+            }
+        }
+        else if (type == "Bus")
+        {
+            if (!catalogue_.RouteExists(name))
+            {
+                throw std::invalid_argument("Bus not found: " + name);
+            }
+            if (operation == Operation::REMOVE)
+            {
+                catalogue_.RemoveRoute(name);
+                return;
+            }
+            // Изменённый маршрут заменяет прежний целиком
+            const transport_catalogue::RouteInput bus = ParseBusRequest(request_dict);
+            catalogue_.AddRoute(bus.name, bus.stops, bus.is_roundtrip);
+        }
+        else
+        {
+            throw json::ParsingError("Unknown request type: " + type);
+        }
+    }
+
+    const std::string &JsonReader::GetStringRef(const json::Dict &dict, const std::string &field_name)
+    {
+        auto it = dict.find(field_name);
+
+        if (it == dict.end())
+        {
+            throw json::ParsingError("Field '" + field_name + "' not found");
+        }
+
+        if (!it->second.IsString())
+        {
+            throw json::ParsingError("Field '" + field_name + "' is not a string");
+        }
+
+        return it->second.AsString();
+    }
+
     std::string JsonReader::GetStringValue(const json::Node &node, const std::string &field_name)
     {
         if (!node.IsDict())
@@ -241,7 +481,11 @@ namespace json_reader
             throw json::ParsingError("Node must be a dictionary to get field: " + field_name);
         }
 
-        const json::Dict &dict = node.AsMap();
+        return GetDoubleValue(node.AsMap(), field_name);
+    }
+
+    double JsonReader::GetDoubleValue(const json::Dict &dict, const std::string &field_name)
+    {
         auto it = dict.find(field_name);
 
         if (it == dict.end())
@@ -262,6 +506,51 @@ namespace json_reader
         return render_settings_;
     }
 
+    SerializationSettings JsonReader::GetSerializationSettings(const json::LazyDocument &document)
+    {
+        const json::LazyNode &root = document.GetRoot();
+        if (!root.IsDict())
+        {
+            throw json::ParsingError("Root node must be a dictionary");
+        }
+
+        const auto settings = root.Find("serialization_settings");
+        if (!settings)
+        {
+            throw json::ParsingError("Document must have 'serialization_settings'");
+        }
+        const json::Node settings_node = settings->Parse();
+        if (!settings_node.IsDict())
+        {
+            throw json::ParsingError("'serialization_settings' must be a dictionary");
+        }
+        const json::Dict &settings_dict = settings_node.AsDict();
+        auto file_it = settings_dict.find("file");
+        if (file_it == settings_dict.end() || !file_it->second.IsString())
+        {
+            throw json::ParsingError("'serialization_settings' must have 'file' field as string");
+        }
+
+        SerializationSettings result;
+        result.file = file_it->second.AsString();
+        if (auto deltas_it = settings_dict.find("deltas"); deltas_it != settings_dict.end())
+        {
+            if (!deltas_it->second.IsArray())
+            {
+                throw json::ParsingError("'deltas' must be an array");
+            }
+            for (const json::Node &delta : deltas_it->second.AsArray())
+            {
+                if (!delta.IsString())
+                {
+                    throw json::ParsingError("'deltas' must contain file names");
+                }
+                result.deltas.push_back(delta.AsString());
+            }
+        }
+        return result;
+    }
+
     map_renderer::RenderSettings JsonReader::ParseRenderSettings(const json::Node &render_settings_node)
     {
         if (!render_settings_node.IsDict())
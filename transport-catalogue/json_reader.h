@@ -1,16 +1,24 @@
 #pragma once
 
 #include "json.h"
+#include "json_lazy.h"
 #include "transport_catalogue.h"
 #include "map_renderer.h"
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <string>
 #include <vector>
 #include <tuple>
 
 namespace json_reader {
 
+// Раздел serialization_settings: файл снимка и дельты, применяемые к нему по порядку
+struct SerializationSettings {
+    std::string file;
+    std::vector<std::string> deltas;
+};
+
 class JsonReader {
 public:
     explicit JsonReader(transport_catalogue::TransportCatalogue& catalogue);
@@ -21,15 +29,35 @@ public:
     // Загрузка JSON документа из строки
     json::Document LoadDocument(const std::string& json_string);
     
+    // Загрузка документа, разбираемого по требованию
+    json::LazyDocument LoadLazyDocument(std::istream& input);
+    
     // Обработка JSON документа для заполнения каталога
     void ProcessDocument(const json::Document& document);
     
+    // Обработка документа, разбираемого по требованию: разбираются только base_requests,
+    // а render_settings откладываются до ResolveRenderSettings
+    void ProcessDocument(const json::LazyDocument& document);
+    
+    // Разбирает отложенные настройки рендеринга. Возвращает true, если настройки изменились
+    bool ResolveRenderSettings();
+    
     // Получение настроек рендеринга
     const map_renderer::RenderSettings& GetRenderSettings() const;
+    
+    // Разбор раздела serialization_settings
+    static SerializationSettings GetSerializationSettings(const json::LazyDocument& document);
 
-private:
-    // Основные методы обработки данных
+    // Загрузка массива base_requests в каталог
     void ProcessBaseRequestsOptimized(const json::Node& base_requests);
+
+private:
+    
+    // Разбор запроса Bus (строки - представления в узле запроса)
+    transport_catalogue::RouteInput ParseBusRequest(const json::Dict& request_dict);
+    
+    // Изменение или удаление остановки либо маршрута (поле operation: update/delete)
+    void ApplyChange(const json::Dict& request_dict);
     
     // Методы для парсинга настроек рендеринга
     map_renderer::RenderSettings ParseRenderSettings(const json::Node& render_settings_node);
@@ -38,12 +66,18 @@ private:
     
     // Вспомогательные методы для получения значений из JSON узлов
     std::string GetStringValue(const json::Node& node, const std::string& field_name);
+    // Ссылка на строку внутри узла, без копирования
+    const std::string& GetStringRef(const json::Dict& dict, const std::string& field_name);
     int GetIntValue(const json::Node& node, const std::string& field_name);
     double GetDoubleValue(const json::Node& node, const std::string& field_name);
+    double GetDoubleValue(const json::Dict& dict, const std::string& field_name);
     
 private:
     transport_catalogue::TransportCatalogue& catalogue_;
     map_renderer::RenderSettings render_settings_;
+    
+    // Ещё не разобранные настройки рендеринга (ссылаются на текст документа)
+    std::optional<json::LazyNode> deferred_render_settings_;
 };
 
 } // namespace json_reader 
\ No newline at end of file
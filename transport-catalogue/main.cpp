@@ -2,27 +2,387 @@
 #include "transport_catalogue.h"
 #include "request_handler.h"
 #include "json_reader.h"
+#include "json_lazy.h"
+#include "versioned_catalogue.h"
+#include "serialization.h"
+#include "catalogue_image.h"
+#include "delta.h"
+#include "parallel.h"
+#include "server.h"
+#include "thread_pool.h"
 #include <iostream>
+#include <filesystem>
 #include <fstream>
+#include <future>
+#include <memory>
 #include <cassert>
+#include <charconv>
 #include <sstream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
-int main() {
+using namespace std::literals;
 
+namespace {
+
+// Размер буфера стандартного вывода: ответы пишутся крупными блоками
+constexpr size_t OUTPUT_BUFFER_SIZE = 1 << 20;
+
+// Параметры командной строки
+struct Options {
+    std::string_view mode;
+    // 0 - число ядер
+    size_t thread_count = 0;
+    // process_requests: отображать снимок в память вместо загрузки
+    bool map_image = false;
+    // Позиционные аргументы режима (файлы для make_delta, путь сокета для serve_socket,
+    // каталог для render_tiles)
+    std::vector<std::string_view> arguments;
+    // serve_socket: адрес HTTP в виде HOST:PORT
+    std::string_view http_address;
+    // serve_socket: число рабочих процессов, 0 - обслуживание в одном процессе
+    size_t process_count = 0;
+    // render_tiles: диапазон уровней плиток, -1 - не задан
+    int min_zoom = -1;
+    int max_zoom = -1;
+};
+
+void PrintUsage(std::ostream& stream) {
+    stream << "Usage: transport_catalogue [serve_lines|make_base|process_requests] [--threads=N] [--mmap]\n"sv;
+    stream << "       transport_catalogue make_delta OLD_BASE NEW_BASE DELTA\n"sv;
+    stream << "       transport_catalogue serve_socket [SOCKET_PATH] [--http=HOST:PORT] [--threads=N] [--processes=N]\n"sv;
+    stream << "       transport_catalogue render_tiles DIR --zoom=MIN[-MAX] [--threads=N]\n"sv;
+    stream << "  (no mode)         read one JSON document from stdin and answer its stat_requests\n"sv;
+    stream << "  serve_lines       read the base document from stdin, then answer each following line\n"sv;
+    stream << "  make_base         build the catalogue from stdin and save it to serialization_settings.file\n"sv;
+    stream << "  process_requests  load serialization_settings.file, apply serialization_settings.deltas\n"sv;
+    stream << "                    and answer stat_requests from stdin\n"sv;
+    stream << "  make_delta        write the changes between two saved bases to DELTA\n"sv;
+    stream << "  serve_socket      read the base document from stdin, then answer request lines\n"sv;
+    stream << "                    of clients connected to the Unix domain socket SOCKET_PATH\n"sv;
+    stream << "  render_tiles      read the base document from stdin and write the non-empty map tiles\n"sv;
+    stream << "                    of the zoom levels MIN..MAX to DIR/Z/X/Y.svg\n"sv;
+    stream << "  --http=HOST:PORT  serve_socket: also accept requests as HTTP/1.1 POST bodies on HOST:PORT\n"sv;
+    stream << "  --processes=N     serve_socket: serve from N pre-forked worker processes sharing the catalogue\n"sv;
+    stream << "                    (base_requests updates are not accepted in this mode)\n"sv;
+    stream << "  --threads=N       execute stat_requests (serve_socket: request lines, render_tiles: tiles)\n"sv;
+    stream << "                    in N threads\n"sv;
+    stream << "                    (default: number of cores)\n"sv;
+    stream << "  --mmap            process_requests: query the mapped snapshot in place instead of loading it\n"sv;
+}
+
+// Возвращает false, если аргументы не распознаны
+bool ParseOptions(int argc, char* argv[], Options& options) {
+    constexpr std::string_view THREADS_PREFIX = "--threads="sv;
+    constexpr std::string_view HTTP_PREFIX = "--http="sv;
+    constexpr std::string_view PROCESSES_PREFIX = "--processes="sv;
+    constexpr std::string_view ZOOM_PREFIX = "--zoom="sv;
+    for (int i = 1; i < argc; ++i) {
+        const std::string_view arg(argv[i]);
+        if (arg.substr(0, THREADS_PREFIX.size()) == THREADS_PREFIX) {
+            const std::string_view value = arg.substr(THREADS_PREFIX.size());
+            const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), options.thread_count);
+            if (error != std::errc{} || end != value.data() + value.size() || options.thread_count == 0) {
+                return false;
+            }
+        } else if (arg.substr(0, PROCESSES_PREFIX.size()) == PROCESSES_PREFIX) {
+            const std::string_view value = arg.substr(PROCESSES_PREFIX.size());
+            const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), options.process_count);
+            if (error != std::errc{} || end != value.data() + value.size() || options.process_count == 0) {
+                return false;
+            }
+        } else if (arg.substr(0, ZOOM_PREFIX.size()) == ZOOM_PREFIX) {
+            // Один уровень или диапазон MIN-MAX
+            const std::string_view value = arg.substr(ZOOM_PREFIX.size());
+            const char* const end = value.data() + value.size();
+            auto [min_end, min_error] = std::from_chars(value.data(), end, options.min_zoom);
+            options.max_zoom = options.min_zoom;
+            if (min_error == std::errc{} && min_end != end && *min_end == '-') {
+                const auto [max_end, max_error] = std::from_chars(min_end + 1, end, options.max_zoom);
+                min_error = max_error;
+                min_end = max_end;
+            }
+            if (min_error != std::errc{} || min_end != end || options.min_zoom < 0 ||
+                options.max_zoom < options.min_zoom || options.max_zoom > map_renderer::MAX_TILE_ZOOM) {
+                return false;
+            }
+        } else if (arg.substr(0, HTTP_PREFIX.size()) == HTTP_PREFIX) {
+            options.http_address = arg.substr(HTTP_PREFIX.size());
+        } else if (arg == "--mmap"sv) {
+            options.map_image = true;
+        } else if (options.mode.empty()) {
+            options.mode = arg;
+        } else {
+            options.arguments.push_back(arg);
+        }
+    }
+    return true;
+}
+
+void ConfigureHandler(request_handler::RequestHandler& handler, const Options& options) {
+    if (options.thread_count != 0) {
+        handler.SetThreadCount(options.thread_count);
+    }
+}
+
+// Однократная обработка: базовые и статистические запросы в одном документе
+void ProcessDocument(transport_catalogue::TransportCatalogue& catalogue, const Options& options) {
+    request_handler::RequestHandler handler(catalogue);
+    ConfigureHandler(handler, options);
+    json_reader::JsonReader reader(catalogue);
+
+    // Загружаем JSON документ. Разделы документа разбираются по мере обращения к ним
+    json::LazyDocument document = reader.LoadLazyDocument(std::cin);
+
+    // Обрабатываем документ для загрузки данных. Дальше каталог только читается
+    handler.ProcessDocument(document);
+    catalogue.Freeze();
+
+    // Обрабатываем запросы
+    handler.ProcessRequests(document);
+}
+
+// Построение базы: каталог и настройки рендеринга сохраняются в двоичный снимок
+void MakeBase(const Options& options) {
     transport_catalogue::TransportCatalogue catalogue;
     request_handler::RequestHandler handler(catalogue);
+    ConfigureHandler(handler, options);
     json_reader::JsonReader reader(catalogue);
 
-    try {
-        // Загружаем JSON документ
-        json::Document document = reader.LoadDocument(std::cin);
+    json::LazyDocument document = reader.LoadLazyDocument(std::cin);
+    const std::string path = json_reader::JsonReader::GetSerializationSettings(document).file;
+    handler.ProcessDocument(document);
+    serialization::SaveCatalogue(path, catalogue, handler.GetRenderSettings());
+}
+
+// Ответы на stat_requests по ранее сохранённому снимку, без разбора base_requests
+void ProcessRequests(const Options& options) {
+    json::LazyDocument document = json::LoadLazy(std::cin);
+    const json_reader::SerializationSettings settings = json_reader::JsonReader::GetSerializationSettings(document);
+
+    // Отображённый образ читается на месте, иначе снимок загружается в обычный каталог.
+    // Образ доступен только для чтения, поэтому при дельтах снимок сразу загружается
+    // в память: копия образа строила бы каталог дважды
+    std::unique_ptr<transport_catalogue::TransportCatalogue> catalogue;
+    map_renderer::RenderSettings render_settings;
+    if (options.map_image && settings.deltas.empty()) {
+        auto image = serialization::CatalogueImage::Open(settings.file);
+        render_settings = image->GetRenderSettings();
+        catalogue = std::make_unique<transport_catalogue::TransportCatalogue>(std::move(image));
+    } else {
+        catalogue = std::make_unique<transport_catalogue::TransportCatalogue>();
+        render_settings = serialization::LoadCatalogue(settings.file, *catalogue);
+    }
+
+    for (const std::string& delta : settings.deltas) {
+        serialization::ApplyDelta(serialization::LoadDelta(delta), *catalogue);
+    }
+    catalogue->Freeze();
 
-        // Обрабатываем документ для загрузки данных
-        handler.ProcessDocument(document);
+    request_handler::RequestHandler handler(*catalogue);
+    ConfigureHandler(handler, options);
+    handler.SetRenderSettings(render_settings);
+    handler.ProcessRequests(document);
+}
+
+// Дельта между двумя сохранёнными базами
+void MakeDelta(const Options& options) {
+    if (options.arguments.size() != 3) {
+        throw std::invalid_argument("make_delta expects OLD_BASE NEW_BASE DELTA");
+    }
+    transport_catalogue::TransportCatalogue from;
+    transport_catalogue::TransportCatalogue to;
+    serialization::LoadCatalogue(std::string(options.arguments[0]), from);
+    serialization::LoadCatalogue(std::string(options.arguments[1]), to);
+    serialization::SaveDelta(std::string(options.arguments[2]), serialization::ComputeDelta(from, to));
+}
 
-        // Обрабатываем запросы
-        handler.ProcessRequests(document);
+// Потоковая обработка (JSON Lines): каталог строится по первому документу,
+// затем каждая следующая строка - независимый запрос, пакет запросов или обновление
+// base_requests, ответ на которые сразу выводится одной строкой.
+// Обновления публикуются как новые версии каталога, не прерывая выполнение запросов
+void ServeLines(const Options& options) {
+    auto catalogue = std::make_unique<transport_catalogue::TransportCatalogue>();
+    request_handler::RequestHandler handler(*catalogue);
+    ConfigureHandler(handler, options);
+
+    handler.ProcessDocument(json::Load(std::cin));
+    transport_catalogue::VersionedCatalogue versions(std::move(catalogue));
+    handler.UseVersions(versions);
+
+    for (std::string line; std::getline(std::cin, line);) {
+        if (line.find_first_not_of(" \t\r"sv) == std::string::npos) {
+            continue;
+        }
+        handler.ProcessRequestLine(line);
+    }
+}
 
+// Разбирает адрес вида HOST:PORT
+std::pair<std::string, uint16_t> ParseHostPort(std::string_view address) {
+    const size_t colon = address.rfind(':');
+    uint16_t port = 0;
+    if (colon != std::string_view::npos) {
+        const std::string_view value = address.substr(colon + 1);
+        const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), port);
+        if (!value.empty() && error == std::errc{} && end == value.data() + value.size()) {
+            return {std::string(address.substr(0, colon)), port};
+        }
+    }
+    throw std::invalid_argument("Expected HOST:PORT, got "s + std::string(address));
+}
+
+// Сервер на локальном сокете и (или) по HTTP: каталог строится по документу из stdin один раз,
+// затем запросы клиентов выполняются так же, как строки режима serve_lines
+void ServeSocket(const Options& options) {
+    if (options.arguments.size() > 1 || (options.arguments.empty() && options.http_address.empty())) {
+        throw std::invalid_argument("serve_socket expects SOCKET_PATH and/or --http=HOST:PORT");
+    }
+
+    auto catalogue = std::make_unique<transport_catalogue::TransportCatalogue>();
+    request_handler::RequestHandler handler(*catalogue);
+    // Строки разных клиентов выполняются параллельно в пуле сервера,
+    // поэтому каждая строка выполняется целиком в одном потоке
+    handler.SetThreadCount(1);
+    handler.ProcessDocument(json::Load(std::cin));
+    handler.GetRenderSettings();
+
+    std::unique_ptr<transport_catalogue::VersionedCatalogue> versions;
+    if (options.process_count == 0) {
+        versions = std::make_unique<transport_catalogue::VersionedCatalogue>(std::move(catalogue));
+        handler.UseVersions(*versions);
+    } else {
+        // Рабочие процессы разделяют страницы каталога, пока никто в них не пишет: индексы
+        // строятся до fork, запросы читают замороженный каталог без счётчиков ссылок и кэшей.
+        // Версии процессов разошлись бы, поэтому обновления в этом режиме не принимаются
+        catalogue->Freeze(parallel::DefaultThreadCount());
+    }
+
+    // В многопроцессном режиме параллельность по умолчанию обеспечивают процессы
+    const size_t default_worker_count = options.process_count == 0 ? parallel::DefaultThreadCount() : 1;
+    const size_t worker_count = options.thread_count != 0 ? options.thread_count : default_worker_count;
+    server::Server server([&handler](std::string_view line) {
+        return handler.AnswerRequestLine(line);
+    }, worker_count);
+    if (!options.arguments.empty()) {
+        server.ListenUnix(std::string(options.arguments[0]));
+    }
+    if (!options.http_address.empty()) {
+        const auto [host, port] = ParseHostPort(options.http_address);
+        // Выбранный системой порт (при PORT=0) нужен клиентам
+        std::cerr << "Listening on http://"sv << host << ':' << server.ListenTcp(host, port) << std::endl;
+    }
+    if (options.process_count == 0) {
+        server.Run();
+    } else {
+        server.RunProcesses(options.process_count);
+    }
+}
+
+// Предварительная отрисовка плиток: каталог строится по документу из stdin, затем плитки
+// заданных уровней отрисовываются в пуле потоков и записываются в DIR/Z/X/Y.svg.
+// Пустые плитки не записываются. Содержимое файлов не зависит от числа потоков
+void RenderTiles(const Options& options) {
+    if (options.arguments.size() != 1 || options.min_zoom < 0) {
+        throw std::invalid_argument("render_tiles expects DIR and --zoom=MIN[-MAX]");
+    }
+    const size_t thread_count = options.thread_count != 0 ? options.thread_count : parallel::DefaultThreadCount();
+
+    transport_catalogue::TransportCatalogue catalogue;
+    request_handler::RequestHandler handler(catalogue);
+    handler.ProcessDocument(json::Load(std::cin));
+    catalogue.Freeze(thread_count);
+    const map_renderer::Render renderer(handler.GetRenderSettings());
+
+    std::vector<map_renderer::TileId> tiles;
+    for (int zoom = options.min_zoom; zoom <= options.max_zoom; ++zoom) {
+        const std::vector<map_renderer::TileId> level = renderer.GetTiles(catalogue, zoom);
+        tiles.insert(tiles.end(), level.begin(), level.end());
+    }
+
+    // Каталоги столбцов создаются заранее, чтобы задачи только записывали файлы.
+    // Плитки уровня идут по строкам, поэтому все столбцы уровня встречаются в его первой строке
+    const std::filesystem::path directory(options.arguments[0]);
+    const auto column_path = [&directory](const map_renderer::TileId& tile) {
+        return directory / std::to_string(tile.z) / std::to_string(tile.x);
+    };
+    uint32_t first_row = 0;
+    for (size_t i = 0; i < tiles.size(); ++i) {
+        if (i == 0 || tiles[i].z != tiles[i - 1].z) {
+            first_row = tiles[i].y;
+        }
+        if (tiles[i].y == first_row) {
+            std::filesystem::create_directories(column_path(tiles[i]));
+        }
+    }
+
+    // По задаче на плитку: плитки нижних уровней намного крупнее, и пул распределяет их сам
+    parallel::ThreadPool pool(thread_count);
+    std::vector<std::future<bool>> written;
+    written.reserve(tiles.size());
+    for (const map_renderer::TileId& tile : tiles) {
+        written.push_back(pool.Submit([&renderer, &catalogue, &column_path, tile] {
+            std::ostringstream svg;
+            if (!renderer.RenderTile(catalogue, tile, svg)) {
+                return false;
+            }
+            const std::filesystem::path path = column_path(tile) / (std::to_string(tile.y) + ".svg");
+            std::ofstream file(path, std::ios::binary);
+            file << std::move(svg).str();
+            file.close();
+            if (!file) {
+                throw std::runtime_error("Cannot write " + path.string());
+            }
+            return true;
+        }));
+    }
+    size_t written_count = 0;
+    for (std::future<bool>& result : written) {
+        written_count += result.get() ? 1 : 0;
+    }
+    std::cerr << "Rendered "sv << written_count << " of "sv << tiles.size() << " tiles to "sv
+              << directory.string() << std::endl;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    const bool parsed = ParseOptions(argc, argv, options);
+    const bool takes_arguments = options.mode == "make_delta"sv || options.mode == "serve_socket"sv ||
+                                 options.mode == "render_tiles"sv;
+    if (!parsed || (!options.arguments.empty() && !takes_arguments)) {
+        PrintUsage(std::cerr);
+        return 1;
+    }
+
+    // Буфер нужно установить до первой операции вывода
+    std::ios::sync_with_stdio(false);
+    static std::vector<char> output_buffer(OUTPUT_BUFFER_SIZE);
+    std::cout.rdbuf()->pubsetbuf(output_buffer.data(), output_buffer.size());
+
+    try {
+        if (options.mode.empty()) {
+            transport_catalogue::TransportCatalogue catalogue;
+            ProcessDocument(catalogue, options);
+        } else if (options.mode == "serve_lines"sv) {
+            ServeLines(options);
+        } else if (options.mode == "make_base"sv) {
+            MakeBase(options);
+        } else if (options.mode == "process_requests"sv) {
+            ProcessRequests(options);
+        } else if (options.mode == "make_delta"sv) {
+            MakeDelta(options);
+        } else if (options.mode == "serve_socket"sv) {
+            ServeSocket(options);
+        } else if (options.mode == "render_tiles"sv) {
+            RenderTiles(options);
+        } else {
+            PrintUsage(std::cerr);
+            return 1;
+        }
     } catch (const json::ParsingError& e) {
         std::cerr << "JSON parsing error: " << e.what() << std::endl;
         return 1;
@@ -1,57 +1,83 @@
 #include "map_renderer.h"
-#include <unordered_set>
+#include "json.h"
+#include <cmath>
+#include <iterator>
 #include <sstream>
+#include <unordered_map>
+#include <unordered_set>
 
 
 namespace map_renderer {
 
-void Render::RenderMap(const transport_catalogue::TransportCatalogue& catalogue, std::ostream& out) const {
-    // Создаем SVG документ
-    svg::Document doc;
-    
-    // Собираем координаты остановок, которые фактически используются в маршрутах
-    std::vector<geo::Coordinates> all_coordinates;
-    std::unordered_set<std::string> used_stops;
-    
-    // Получаем все маршруты и собираем используемые остановки
-    auto routes = catalogue.GetRouteContainer().GetAllRoutes();
-    for (const auto& route : routes) {
-        for (const auto& stop : route->stops) {
-            if (stop && (stop->coordinates.lat != 0.0 || stop->coordinates.lng != 0.0)) {
-                used_stops.insert(stop->name);
-            }
-        }
-    }
+namespace {
+
+// Предел общего размера плиток в кэше, байт
+constexpr size_t TILE_CACHE_SIZE = size_t{64} << 20;
+
+} // namespace
+
+Render::Render(const RenderSettings& settings)
+    : settings_(settings), cache_(std::make_shared<MapCache>()), tiles_(std::make_shared<TileCache>()) {
+}
+
+std::shared_ptr<const RenderedMap> Render::GetMap(const transport_catalogue::TransportCatalogue& catalogue) const {
+    const uint64_t version = catalogue.GetVersion();
     
-    // Добавляем координаты только используемых остановок
-    auto all_stops = catalogue.GetStopContainer().GetAllStops();
-    for (const auto& stop : all_stops) {
-        if (used_stops.count(stop->name) > 0) {
-            all_coordinates.push_back(stop->coordinates);
-        }
+    // Карта отрисовывается под мьютексом: одновременные запросы дожидаются первой отрисовки
+    std::lock_guard lock(cache_->mutex);
+    if (cache_->map && cache_->map->catalogue_version == version) {
+        return cache_->map;
     }
     
-    // Создаем проектор
-    SphereProjector projector(all_coordinates.begin(), all_coordinates.end(),
-                             settings_.width, settings_.height, settings_.padding);
+    auto map = std::make_shared<RenderedMap>();
+    map->catalogue_version = version;
+    std::ostringstream svg;
+    RenderMap(catalogue, svg);
+    map->svg = std::move(svg).str();
+    std::ostringstream json_string;
+    json::PrintString(map->svg, json_string);
+    map->json = std::move(json_string).str();
     
-    // Если нет валидных координат, выводим пустой SVG
-    if (all_coordinates.empty()) {
-        doc.Render(out);
-        return;
+    // Запрос к более старой версии каталога (начатый до обновления) не вытесняет новую карту
+    if (!cache_->map || cache_->map->catalogue_version < version) {
+        cache_->map = map;
     }
+    return map;
+}
+
+namespace {
+
+// Остановки без координат на карте не отображаются
+bool HasCoordinates(const Stop* stop) {
+    return stop && (stop->coordinates.lat != 0.0 || stop->coordinates.lng != 0.0);
+}
+
+bool LessByName(const Stop* lhs, const Stop* rhs) {
+    return lhs->name.compare(rhs->name) < 0;
+}
+
+} // namespace
+
+void Render::RenderMap(const transport_catalogue::TransportCatalogue& catalogue, std::ostream& out) const {
+    // Создаем SVG документ
+    svg::Document doc;
     
-    // Рендерим только линии маршрутов
-    RenderBusLines(catalogue, projector, doc);
-    
-    // Рендерим названия маршрутов
-    RenderBusLabels(catalogue, projector, doc);
-    
-    // Рендерим символы остановок
-    RenderStopSymbols(catalogue, projector, doc);
+    const Scene scene = PrepareScene(catalogue);
     
-    // Рендерим названия остановок
-    RenderStopLabels(catalogue, projector, doc);
+    // Если нет валидных координат, сцена пуста и выводится пустой SVG
+    if (!scene.stops.empty()) {
+        // Рендерим только линии маршрутов
+        RenderBusLines(scene, doc);
+        
+        // Рендерим названия маршрутов
+        RenderBusLabels(scene, doc);
+        
+        // Рендерим символы остановок
+        RenderStopSymbols(scene, doc);
+        
+        // Рендерим названия остановок
+        RenderStopLabels(scene, doc);
+    }
     
     // Выводим SVG документ
     doc.Render(out);
@@ -85,238 +111,770 @@ std::string Render::ColorToString(const map_renderer::Color& color) const {
     return "black"; // fallback
 }
 
-void Render::RenderBusLines(const transport_catalogue::TransportCatalogue& catalogue,
-                           const SphereProjector& projector, svg::Document& doc) const {
-    auto routes = catalogue.GetRouteContainer().GetAllRoutes();
+Render::Scene Render::PrepareScene(const transport_catalogue::TransportCatalogue& catalogue) const {
+    Scene scene;
     
-    // Сортируем маршруты по названиям в лексикографическом порядке
+    // Маршруты по названию в лексикографическом порядке
+    auto routes = catalogue.GetRouteContainer().GetAllRoutes();
     std::sort(routes.begin(), routes.end(), 
               [](const Route* a, const Route* b) { 
                   return a->name.compare(b->name) < 0;
               });
     
-    size_t color_index = 0;
+    // Используемые остановки собираются по указателям: имена остановок уникальны,
+    // поэтому хешировать строки не нужно. Значение - индекс остановки в сцене
+    std::unordered_map<const Stop*, uint32_t> stop_indices;
+    for (const auto& route : routes) {
+        for (const auto& stop : route->stops) {
+            if (HasCoordinates(stop)) {
+                stop_indices.emplace(stop, 0);
+            }
+        }
+    }
+    
+    if (stop_indices.empty()) {
+        return scene;
+    }
+    
+    scene.stops.reserve(stop_indices.size());
+    for (const auto& [stop, index] : stop_indices) {
+        scene.stops.push_back(stop);
+    }
+    std::sort(scene.stops.begin(), scene.stops.end(), LessByName);
+    
+    // Координаты остановок раскладываются по отдельным массивам и проецируются одним проходом
+    const size_t stop_count = scene.stops.size();
+    std::vector<geo::Coordinates> all_coordinates;
+    all_coordinates.reserve(stop_count);
+    scene.lats.reserve(stop_count);
+    scene.lngs.reserve(stop_count);
+    for (uint32_t i = 0; i < stop_count; ++i) {
+        const Stop* stop = scene.stops[i];
+        stop_indices[stop] = i;
+        all_coordinates.push_back(stop->coordinates);
+        scene.lats.push_back(stop->coordinates.lat);
+        scene.lngs.push_back(stop->coordinates.lng);
+    }
+    scene.projector = SphereProjector(all_coordinates.begin(), all_coordinates.end(),
+                                      settings_.width, settings_.height, settings_.padding);
+    scene.xs.resize(stop_count);
+    scene.ys.resize(stop_count);
+    scene.projector.Project(scene.lats.data(), scene.lngs.data(), stop_count, scene.xs.data(), scene.ys.data());
     
+    // Цвета выдаются по порядку непустым маршрутам
+    size_t color_index = 0;
+    scene.routes.reserve(routes.size());
     for (const auto& route : routes) {
         // Пропускаем маршруты без остановок
         if (route->stops.empty()) continue;
         
-        // Создаем полилинию для маршрута
-        svg::Polyline polyline;
+        Scene::RouteItem& item = scene.routes.emplace_back();
+        item.route = route;
+        if (settings_.color_palette.empty()) {
+            item.color = "black"; // fallback цвет при пустой палитре
+        } else {
+            item.color = ColorToString(settings_.color_palette[color_index % settings_.color_palette.size()]);
+        }
+        color_index++;
         
-        // Добавляем точки маршрута в порядке следования
+        // Добавляем все остановки без фильтрации дубликатов
+        item.stops.reserve(route->stops.size());
         for (const auto& stop : route->stops) {
-            if (stop && (stop->coordinates.lat != 0.0 || stop->coordinates.lng != 0.0)) {
-                svg::Point point = projector(stop->coordinates);
-                
-                // Добавляем все точки без фильтрации дубликатов
-                polyline.AddPoint(point);
+            if (HasCoordinates(stop)) {
+                item.stops.push_back(stop_indices.at(stop));
             }
         }
         
-        // Настраиваем стиль линии согласно требованиям
-        std::string stroke_color;
-        if (settings_.color_palette.empty()) {
-            stroke_color = "black"; // fallback цвет при пустой палитре
-        } else {
-            stroke_color = ColorToString(settings_.color_palette[color_index % settings_.color_palette.size()]);
+        // Для кольцевого маршрута конечная - первая остановка, для некольцевого - первая
+        // и последняя из оригинального маршрута
+        const Stop* first = route->stops.front();
+        const Stop* last = nullptr;
+        if (!route->is_roundtrip) {
+            size_t original_size = (route->stops.size() + 1) / 2; // Округляем вверх
+            if (original_size > 1 && first != route->stops[original_size - 1]) {
+                last = route->stops[original_size - 1];
+            }
+        }
+        for (const Stop* stop : {first, last}) {
+            if (HasCoordinates(stop)) {
+                item.terminals.push_back(stop_indices.at(stop));
+            }
         }
-        polyline.SetStrokeColor(stroke_color);
-        polyline.SetFillColor("none");
-        polyline.SetStrokeWidth(settings_.line_width);
-        polyline.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
-        polyline.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-        
-        doc.Add(polyline);
-        color_index++;
     }
+    
+    scene.underlayer_color = ColorToString(settings_.underlayer_color);
+    return scene;
 }
 
-void Render::RenderBusLabels(const transport_catalogue::TransportCatalogue& catalogue,
-                            const SphereProjector& projector, svg::Document& doc) const {
-    auto routes = catalogue.GetRouteContainer().GetAllRoutes();
+std::shared_ptr<const Render::IndexedScene> Render::GetIndexedScene(const transport_catalogue::TransportCatalogue& catalogue) const {
+    const uint64_t version = catalogue.GetVersion();
     
-    // Сортируем маршруты по названиям в алфавитном порядке
-    std::sort(routes.begin(), routes.end(), 
-              [](const Route* a, const Route* b) { 
-                  return a->name.compare(b->name) < 0;
-              });
+    std::lock_guard lock(cache_->mutex);
+    if (cache_->indexed_scene && cache_->indexed_scene->catalogue_version == version) {
+        return cache_->indexed_scene;
+    }
     
-    size_t color_index = 0;
+    auto indexed = std::make_shared<IndexedScene>();
+    indexed->catalogue_version = version;
+    indexed->scene = PrepareScene(catalogue);
+    const Scene& scene = indexed->scene;
     
-    for (const auto& route : routes) {
-        // Пропускаем маршруты без остановок
-        if (route->stops.empty()) continue;
-        
-        // Получаем цвет маршрута
-        std::string route_color;
-        if (settings_.color_palette.empty()) {
-            route_color = "black"; // fallback цвет при пустой палитре
-        } else {
-            route_color = ColorToString(settings_.color_palette[color_index % settings_.color_palette.size()]);
+    // Полная геометрия: линии проходят через все остановки маршрутов, выводятся все остановки
+    std::vector<std::vector<uint32_t>> routes;
+    routes.reserve(scene.routes.size());
+    for (const auto& route : scene.routes) {
+        routes.push_back(route.stops);
+    }
+    std::vector<uint32_t> stops(scene.stops.size());
+    for (uint32_t i = 0; i < stops.size(); ++i) {
+        stops[i] = i;
+    }
+    indexed->geometry = MakeGeometry(scene, std::move(routes), std::move(stops),
+                                     std::vector<bool>(scene.stops.size(), true));
+    
+    if (!cache_->indexed_scene || cache_->indexed_scene->catalogue_version < version) {
+        cache_->indexed_scene = indexed;
+    }
+    return indexed;
+}
+
+Render::Geometry Render::MakeGeometry(const Scene& scene, std::vector<std::vector<uint32_t>> routes,
+                                      std::vector<uint32_t> stops, std::vector<bool> labeled) {
+    Geometry geometry;
+    geometry.routes = std::move(routes);
+    geometry.stops = std::move(stops);
+    geometry.labeled = std::move(labeled);
+    
+    std::vector<Segment> segments;
+    segments.reserve(geometry.stops.size());
+    for (const uint32_t stop : geometry.stops) {
+        segments.push_back({scene.lngs[stop], scene.lats[stop], scene.lngs[stop], scene.lats[stop]});
+    }
+    geometry.stop_index = GridIndex(segments);
+    
+    segments.clear();
+    geometry.segment_starts.reserve(geometry.routes.size() + 1);
+    for (const std::vector<uint32_t>& line : geometry.routes) {
+        geometry.segment_starts.push_back(static_cast<uint32_t>(segments.size()));
+        const size_t segment_count = line.size() == 1 ? 1 : (line.empty() ? 0 : line.size() - 1);
+        for (size_t k = 0; k < segment_count; ++k) {
+            const uint32_t from = line[k];
+            const uint32_t to = line[std::min(k + 1, line.size() - 1)];
+            segments.push_back({scene.lngs[from], scene.lats[from], scene.lngs[to], scene.lats[to]});
         }
-        
-        // Определяем конечные остановки
-        std::vector<const Stop*> terminal_stops;
-        
-        if (route->is_roundtrip) {
-            // Для кольцевого маршрута конечная - первая остановка
-            if (!route->stops.empty()) {
-                terminal_stops.push_back(route->stops.front());
+    }
+    geometry.segment_starts.push_back(static_cast<uint32_t>(segments.size()));
+    geometry.segments = GridIndex(segments);
+    return geometry;
+}
+
+SphereProjector Render::MakeProjector(const Scene& scene, const Viewport& viewport) const {
+    if (const auto* bounds = std::get_if<ViewportBounds>(&viewport)) {
+        const geo::Coordinates corners[] = {bounds->min, bounds->max};
+        return SphereProjector(std::begin(corners), std::end(corners),
+                               settings_.width, settings_.height, settings_.padding);
+    }
+    
+    // Масштаб отсчитывается от полной карты. Если вся сеть - одна точка, масштаба нет
+    const auto& center = std::get<ViewportCenter>(viewport);
+    const double zoom_coeff = scene.projector.GetZoom() * center.zoom;
+    if (IsZero(zoom_coeff)) {
+        return scene.projector;
+    }
+    return SphereProjector(center.center.lng - settings_.width / 2 / zoom_coeff,
+                           center.center.lat + settings_.height / 2 / zoom_coeff, zoom_coeff, 0.0);
+}
+
+namespace {
+
+// Отсекает отрезок from-to прямоугольником (алгоритм Лианга - Барски).
+// Возвращает параметры начала и конца видимой части или nullopt, если отрезок не виден
+std::optional<std::pair<double, double>> ClipSegment(svg::Point from, svg::Point to, const Rect& rect) {
+    const double dx = to.x - from.x;
+    const double dy = to.y - from.y;
+    const double p[] = {-dx, dx, -dy, dy};
+    const double q[] = {from.x - rect.min_x, rect.max_x - from.x, from.y - rect.min_y, rect.max_y - from.y};
+    double t0 = 0.0;
+    double t1 = 1.0;
+    for (int i = 0; i < 4; ++i) {
+        if (p[i] == 0.0) {
+            // Отрезок параллелен границе
+            if (q[i] < 0.0) {
+                return std::nullopt;
+            }
+            continue;
+        }
+        const double t = q[i] / p[i];
+        if (p[i] < 0.0) {
+            if (t > t1) {
+                return std::nullopt;
             }
+            t0 = std::max(t0, t);
         } else {
-            // Для некольцевого маршрута конечные - первая и последняя из оригинального маршрута
-            if (!route->stops.empty()) {
-                size_t original_size = (route->stops.size() + 1) / 2; // Округляем вверх
-                terminal_stops.push_back(route->stops.front());
-                if (original_size > 1 && route->stops.front() != route->stops[original_size - 1]) {
-                    terminal_stops.push_back(route->stops[original_size - 1]);
-                }
+            if (t < t0) {
+                return std::nullopt;
             }
+            t1 = std::min(t1, t);
         }
+    }
+    return std::make_pair(t0, t1);
+}
+
+svg::Point Interpolate(svg::Point from, svg::Point to, double t) {
+    if (t == 0.0) {
+        return from;
+    }
+    if (t == 1.0) {
+        return to;
+    }
+    return {from.x + (to.x - from.x) * t, from.y + (to.y - from.y) * t};
+}
+
+} // namespace
+
+void Render::RenderMap(const transport_catalogue::TransportCatalogue& catalogue, const Viewport& viewport,
+                       std::ostream& out) const {
+    svg::Document doc;
+    
+    const auto indexed = GetIndexedScene(catalogue);
+    const Scene& scene = indexed->scene;
+    if (!scene.stops.empty()) {
+        const SphereProjector projector = MakeProjector(scene, viewport);
+        const Rect canvas{0.0, 0.0, settings_.width, settings_.height};
         
-        // Рендерим названия для каждой конечной остановки
-        for (const auto& stop : terminal_stops) {
-            if (stop && (stop->coordinates.lat != 0.0 || stop->coordinates.lng != 0.0)) {
-                svg::Point point = projector(stop->coordinates);
-                
-                // Создаем подложку (background)
-                svg::Text background;
-                background.SetPosition(point);
-                background.SetOffset({settings_.bus_label_offset.dx, settings_.bus_label_offset.dy});
-                background.SetFontSize(settings_.bus_label_font_size);
-                background.SetFontFamily("Verdana");
-                background.SetFontWeight("bold");
-                background.SetData(route->name);
-                background.SetFillColor(ColorToString(settings_.underlayer_color));
-                background.SetStrokeColor(ColorToString(settings_.underlayer_color));
-                background.SetStrokeWidth(settings_.underlayer_width);
-                background.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
-                background.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-                
-                // Создаем основную надпись
-                svg::Text label;
-                label.SetPosition(point);
-                label.SetOffset({settings_.bus_label_offset.dx, settings_.bus_label_offset.dy});
-                label.SetFontSize(settings_.bus_label_font_size);
-                label.SetFontFamily("Verdana");
-                label.SetFontWeight("bold");
-                label.SetData(route->name);
-                label.SetFillColor(route_color);
-                
-                // Добавляем в документ (сначала подложку, потом надпись)
-                doc.Add(background);
-                doc.Add(label);
-            }
-        }
+        // Географическая область холста с запасом на погрешность обратной проекции
+        const geo::Coordinates top_left = projector.Unproject({canvas.min_x, canvas.min_y});
+        const geo::Coordinates bottom_right = projector.Unproject({canvas.max_x, canvas.max_y});
+        const double margin = IsZero(projector.GetZoom()) ? 0.0 : 1.0 / projector.GetZoom();
+        const Rect area{top_left.lng - margin, bottom_right.lat - margin,
+                        bottom_right.lng + margin, top_left.lat + margin};
         
-        color_index++;
+        const auto level = GetViewportGeometry(*indexed, projector.GetZoom());
+        RenderArea(scene, level ? *level : indexed->geometry, area, canvas, projector, doc);
     }
+    
+    doc.Render(out);
 }
 
-void Render::RenderStopSymbols(const transport_catalogue::TransportCatalogue& catalogue,
-                              const SphereProjector& projector, svg::Document& doc) const {
-    // Собираем все остановки, которые используются в маршрутах
-    std::unordered_set<std::string> used_stops;
-    auto routes = catalogue.GetRouteContainer().GetAllRoutes();
-    
-    for (const auto& route : routes) {
-        for (const auto& stop : route->stops) {
-            if (stop && (stop->coordinates.lat != 0.0 || stop->coordinates.lng != 0.0)) {
-                used_stops.insert(stop->name);
+namespace {
+
+// Запас вокруг плитки в точках: линии, символы и названия объектов соседних плиток,
+// заходящие на плитку, отрисовываются и на ней
+constexpr double TILE_BUFFER = 64.0;
+
+// Широта, на которой квадратная проекция Web Mercator заканчивается
+constexpr double MAX_MERCATOR_LAT = 85.0511287798066;
+
+constexpr double PI = 3.14159265358979323846;
+
+// Допуск упрощения линий маршрутов в точках уровня: отброшенные вершины
+// отстоят от упрощённой линии меньше чем на точку и на холсте неразличимы
+constexpr double LINE_TOLERANCE = 1.0;
+
+// Координаты Web Mercator в точках на уровне, где ширина мира - world_size
+double LngToWorldX(double lng, double world_size) {
+    return (lng + 180.0) / 360.0 * world_size;
+}
+
+double LatToWorldY(double lat, double world_size) {
+    const double sin_lat = std::sin(std::clamp(lat, -MAX_MERCATOR_LAT, MAX_MERCATOR_LAT) * PI / 180.0);
+    return (0.5 - std::log((1.0 + sin_lat) / (1.0 - sin_lat)) / (4.0 * PI)) * world_size;
+}
+
+double WorldXToLng(double x, double world_size) {
+    return x / world_size * 360.0 - 180.0;
+}
+
+double WorldYToLat(double y, double world_size) {
+    return std::atan(std::sinh(PI * (1.0 - 2.0 * y / world_size))) * 180.0 / PI;
+}
+
+double GetWorldSize(int zoom) {
+    return std::ldexp(TILE_SIZE, zoom);
+}
+
+void CheckTile(const TileId& tile) {
+    if (!tile.IsValid()) {
+        throw std::invalid_argument("Tile " + std::to_string(tile.z) + "/" + std::to_string(tile.x) + "/" +
+                                    std::to_string(tile.y) + " does not exist");
+    }
+}
+
+// Расстояние от точки p до отрезка ab
+double DistanceToSegment(svg::Point p, svg::Point a, svg::Point b) {
+    const double dx = b.x - a.x;
+    const double dy = b.y - a.y;
+    const double length2 = dx * dx + dy * dy;
+    double t = length2 > 0 ? ((p.x - a.x) * dx + (p.y - a.y) * dy) / length2 : 0.0;
+    t = std::clamp(t, 0.0, 1.0);
+    return std::hypot(p.x - a.x - t * dx, p.y - a.y - t * dy);
+}
+
+// Упрощение линии алгоритмом Дугласа - Пекера: из вершин line (индексов точек points)
+// остаются концы и вершины, отстоящие от упрощённой линии дальше tolerance
+std::vector<uint32_t> SimplifyLine(const std::vector<uint32_t>& line, const std::vector<svg::Point>& points,
+                                   double tolerance) {
+    if (line.size() <= 2) {
+        return line;
+    }
+    std::vector<bool> kept(line.size(), false);
+    kept.front() = kept.back() = true;
+    // Стек участков вместо рекурсии: на длинных линиях рекурсия может быть глубокой
+    std::vector<std::pair<size_t, size_t>> ranges{{0, line.size() - 1}};
+    while (!ranges.empty()) {
+        const auto [first, last] = ranges.back();
+        ranges.pop_back();
+        double max_distance = tolerance;
+        size_t farthest = first;
+        for (size_t k = first + 1; k < last; ++k) {
+            const double distance = DistanceToSegment(points[line[k]], points[line[first]], points[line[last]]);
+            if (distance > max_distance) {
+                max_distance = distance;
+                farthest = k;
             }
         }
+        if (farthest != first) {
+            kept[farthest] = true;
+            ranges.emplace_back(first, farthest);
+            ranges.emplace_back(farthest, last);
+        }
     }
     
-    // Получаем все остановки и фильтруем только используемые
-    std::vector<const Stop*> stops_to_render;
-    auto all_stops = catalogue.GetStopContainer().GetAllStops();
+    std::vector<uint32_t> result;
+    for (size_t k = 0; k < line.size(); ++k) {
+        if (kept[k]) {
+            result.push_back(line[k]);
+        }
+    }
+    return result;
+}
+
+// Оставляет из candidates (в порядке убывания важности) по одной остановке на ячейку сетки
+// cell_width x cell_height, привязанной к началу мира: сетка одна для всех плиток уровня,
+// поэтому соседние плитки сходятся на границах
+std::vector<uint32_t> ThinOut(const std::vector<uint32_t>& candidates, const std::vector<svg::Point>& points,
+                              double cell_width, double cell_height) {
+    std::vector<uint32_t> result;
+    std::unordered_set<uint64_t> occupied;
+    for (const uint32_t stop : candidates) {
+        const auto column = static_cast<uint64_t>(std::floor(points[stop].x / cell_width));
+        const auto row = static_cast<uint64_t>(std::floor(points[stop].y / cell_height));
+        if (occupied.insert(column << 32 | row).second) {
+            result.push_back(stop);
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+std::shared_ptr<const Render::Geometry> Render::GetLevelGeometry(const IndexedScene& indexed, int zoom) const {
+    std::lock_guard lock(indexed.levels_mutex);
+    std::shared_ptr<const Geometry>& level = indexed.levels[zoom];
+    if (!level) {
+        const Scene& scene = indexed.scene;
+        const double world_size = GetWorldSize(zoom);
+        std::vector<svg::Point> points(scene.stops.size());
+        for (size_t i = 0; i < points.size(); ++i) {
+            points[i] = {LngToWorldX(scene.lngs[i], world_size), LatToWorldY(scene.lats[i], world_size)};
+        }
+        level = std::make_shared<const Geometry>(MakeLevelGeometry(scene, points));
+    }
+    return level;
+}
+
+std::shared_ptr<const Render::Geometry> Render::GetViewportGeometry(const IndexedScene& indexed,
+                                                                    double zoom_coeff) const {
+    const Scene& scene = indexed.scene;
+    const double full_zoom = scene.projector.GetZoom();
+    if (IsZero(full_zoom) || IsZero(zoom_coeff)) {
+        return nullptr;
+    }
+    
+    // Масштаб округляется вверх до степени двойки от масштаба полной карты,
+    // поэтому допуск в точку уровня на холсте не больше точки
+    const int level_zoom = std::max(static_cast<int>(std::ceil(std::log2(zoom_coeff / full_zoom))), -MAX_TILE_ZOOM);
+    if (level_zoom > MAX_TILE_ZOOM) {
+        return nullptr;
+    }
     
-    for (const auto& stop : all_stops) {
-        if (used_stops.count(stop->name) > 0) {
-            stops_to_render.push_back(stop);
+    std::lock_guard lock(indexed.levels_mutex);
+    std::shared_ptr<const Geometry>& level = indexed.viewport_levels[level_zoom + MAX_TILE_ZOOM];
+    if (!level) {
+        // Точки полной карты без отступа, увеличенные до масштаба уровня. Сетка прореживания
+        // привязана к углу сети, поэтому одна для всех частей карты этого масштаба
+        const double padding = settings_.padding;
+        std::vector<svg::Point> points(scene.stops.size());
+        for (size_t i = 0; i < points.size(); ++i) {
+            points[i] = {std::ldexp(std::max(scene.xs[i] - padding, 0.0), level_zoom),
+                         std::ldexp(std::max(scene.ys[i] - padding, 0.0), level_zoom)};
+        }
+        level = std::make_shared<const Geometry>(MakeLevelGeometry(scene, points));
+    }
+    return level;
+}
+
+Render::Geometry Render::MakeLevelGeometry(const Scene& scene, const std::vector<svg::Point>& points) const {
+    std::vector<std::vector<uint32_t>> routes;
+    routes.reserve(scene.routes.size());
+    std::vector<uint32_t> route_counts(scene.stops.size(), 0);
+    for (const auto& route : scene.routes) {
+        routes.push_back(SimplifyLine(route.stops, points, LINE_TOLERANCE));
+        std::vector<uint32_t> route_stops = route.stops;
+        std::sort(route_stops.begin(), route_stops.end());
+        route_stops.erase(std::unique(route_stops.begin(), route_stops.end()), route_stops.end());
+        for (const uint32_t stop : route_stops) {
+            ++route_counts[stop];
         }
     }
     
-    // Сортируем остановки по названию в лексикографическом порядке
-    std::sort(stops_to_render.begin(), stops_to_render.end(),
-              [](const Stop* a, const Stop* b) {
-                  return a->name.compare(b->name) < 0;
-              });
+    // Первыми остаются остановки с большим числом маршрутов, при равенстве - по названию
+    std::vector<uint32_t> candidates(scene.stops.size());
+    for (uint32_t i = 0; i < candidates.size(); ++i) {
+        candidates[i] = i;
+    }
+    std::stable_sort(candidates.begin(), candidates.end(), [&route_counts](uint32_t a, uint32_t b) {
+        return route_counts[a] > route_counts[b];
+    });
+    // Символы не ближе четырёх радиусов друг к другу. Название в среднем около десяти
+    // символов шириной около 0.6 кегля, ячейка названия - шесть кеглей на два
+    const double symbol_cell = std::max(4.0 * settings_.stop_radius, 1.0);
+    const double label_size = std::max(static_cast<double>(settings_.stop_label_font_size), 1.0);
+    const std::vector<uint32_t> symbols = ThinOut(candidates, points, symbol_cell, symbol_cell);
+    const std::vector<uint32_t> labels = ThinOut(symbols, points, 6.0 * label_size, 2.0 * label_size);
     
-    // Рендерим символы остановок
-    for (const auto& stop : stops_to_render) {
-        svg::Point point = projector(stop->coordinates);
+    // Остановки геометрии по названию, как в полной
+    std::vector<uint32_t> stops = symbols;
+    std::sort(stops.begin(), stops.end());
+    std::vector<bool> labeled(scene.stops.size(), false);
+    for (const uint32_t stop : labels) {
+        labeled[stop] = true;
+    }
+    std::vector<bool> stop_labeled;
+    stop_labeled.reserve(stops.size());
+    for (const uint32_t stop : stops) {
+        stop_labeled.push_back(labeled[stop]);
+    }
+    
+    return MakeGeometry(scene, std::move(routes), std::move(stops), std::move(stop_labeled));
+}
+
+bool Render::RenderTile(const transport_catalogue::TransportCatalogue& catalogue, const TileId& tile,
+                        std::ostream& out) const {
+    CheckTile(tile);
+    svg::Document doc;
+    bool has_objects = false;
+    
+    const auto indexed = GetIndexedScene(catalogue);
+    if (!indexed->scene.stops.empty()) {
+        const double world_size = GetWorldSize(tile.z);
+        const double left = tile.x * TILE_SIZE;
+        const double top = tile.y * TILE_SIZE;
+        const Rect canvas{-TILE_BUFFER, -TILE_BUFFER, TILE_SIZE + TILE_BUFFER, TILE_SIZE + TILE_BUFFER};
         
-        svg::Circle circle;
-        circle.SetCenter(point);
-        circle.SetRadius(settings_.stop_radius);
-        circle.SetFillColor("white");
+        // Точка мира занимает 360 / world_size градусов долготы и не больше того же по широте
+        const double margin = 360.0 / world_size;
+        const Rect area{WorldXToLng(left + canvas.min_x, world_size) - margin,
+                        WorldYToLat(top + canvas.max_y, world_size) - margin,
+                        WorldXToLng(left + canvas.max_x, world_size) + margin,
+                        WorldYToLat(top + canvas.min_y, world_size) + margin};
         
-        doc.Add(circle);
+        const auto project = [world_size, left, top](geo::Coordinates coordinates) {
+            return svg::Point{LngToWorldX(coordinates.lng, world_size) - left,
+                              LatToWorldY(coordinates.lat, world_size) - top};
+        };
+        has_objects = RenderArea(indexed->scene, *GetLevelGeometry(*indexed, tile.z), area, canvas, project, doc);
     }
+    
+    doc.Render(out);
+    return has_objects;
 }
 
-void Render::RenderStopLabels(const transport_catalogue::TransportCatalogue& catalogue,
-                             const SphereProjector& projector, svg::Document& doc) const {
-    // Собираем все остановки, которые используются в маршрутах
-    std::unordered_set<std::string> used_stops;
-    auto routes = catalogue.GetRouteContainer().GetAllRoutes();
+std::shared_ptr<const RenderedMap> Render::GetTile(const transport_catalogue::TransportCatalogue& catalogue,
+                                                   const TileId& tile) const {
+    CheckTile(tile);
+    const uint64_t version = catalogue.GetVersion();
+    const uint64_t key = (uint64_t(tile.z) << 56) | (uint64_t(tile.x) << 28) | tile.y;
     
-    for (const auto& route : routes) {
-        for (const auto& stop : route->stops) {
-            if (stop && (stop->coordinates.lat != 0.0 || stop->coordinates.lng != 0.0)) {
-                used_stops.insert(stop->name);
+    {
+        std::lock_guard lock(tiles_->mutex);
+        if (tiles_->catalogue_version == version) {
+            if (auto it = tiles_->positions.find(key); it != tiles_->positions.end()) {
+                tiles_->entries.splice(tiles_->entries.begin(), tiles_->entries, it->second);
+                return it->second->tile;
             }
         }
     }
     
-    // Получаем все остановки и фильтруем только используемые
-    std::vector<const Stop*> stops_to_render;
-    auto all_stops = catalogue.GetStopContainer().GetAllStops();
+    // Плитка отрисовывается без блокировки, чтобы разные плитки отрисовывались параллельно.
+    // Одновременные запросы одной и той же новой плитки могут отрисовать её несколько раз
+    auto rendered = std::make_shared<RenderedMap>();
+    rendered->catalogue_version = version;
+    std::ostringstream svg;
+    RenderTile(catalogue, tile, svg);
+    rendered->svg = std::move(svg).str();
+    std::ostringstream json_string;
+    json::PrintString(rendered->svg, json_string);
+    rendered->json = std::move(json_string).str();
     
-    for (const auto& stop : all_stops) {
-        if (used_stops.count(stop->name) > 0) {
-            stops_to_render.push_back(stop);
+    std::lock_guard lock(tiles_->mutex);
+    if (tiles_->catalogue_version > version) {
+        // Запрос к более старой версии каталога кэш не заполняет
+        return rendered;
+    }
+    if (tiles_->catalogue_version < version) {
+        tiles_->entries.clear();
+        tiles_->positions.clear();
+        tiles_->size = 0;
+        tiles_->catalogue_version = version;
+    }
+    if (tiles_->positions.count(key) == 0) {
+        tiles_->entries.push_front({key, rendered});
+        tiles_->positions.emplace(key, tiles_->entries.begin());
+        tiles_->size += rendered->svg.size() + rendered->json.size();
+        while (tiles_->size > TILE_CACHE_SIZE && tiles_->entries.size() > 1) {
+            const TileCache::Entry& oldest = tiles_->entries.back();
+            tiles_->size -= oldest.tile->svg.size() + oldest.tile->json.size();
+            tiles_->positions.erase(oldest.key);
+            tiles_->entries.pop_back();
         }
     }
+    return rendered;
+}
+
+std::vector<TileId> Render::GetTiles(const transport_catalogue::TransportCatalogue& catalogue, int zoom) const {
+    CheckTile({zoom, 0, 0});
+    std::vector<TileId> tiles;
+    const auto indexed = GetIndexedScene(catalogue);
+    if (indexed->scene.stops.empty()) {
+        return tiles;
+    }
     
-    // Сортируем остановки по названию в лексикографическом порядке
-    std::sort(stops_to_render.begin(), stops_to_render.end(),
-              [](const Stop* a, const Stop* b) {
-                  return a->name.compare(b->name) < 0;
-              });
+    // Плитки, на которые заходят объекты у края сети, тоже входят в диапазон
+    const Rect& bounds = indexed->geometry.stop_index.GetBounds();
+    const double world_size = GetWorldSize(zoom);
+    const auto to_tile = [world_size](double world) {
+        return static_cast<uint32_t>(std::clamp(std::floor(world / TILE_SIZE), 0.0, world_size / TILE_SIZE - 1.0));
+    };
+    const uint32_t min_x = to_tile(LngToWorldX(bounds.min_x, world_size) - TILE_BUFFER);
+    const uint32_t max_x = to_tile(LngToWorldX(bounds.max_x, world_size) + TILE_BUFFER);
+    const uint32_t min_y = to_tile(LatToWorldY(bounds.max_y, world_size) - TILE_BUFFER);
+    const uint32_t max_y = to_tile(LatToWorldY(bounds.min_y, world_size) + TILE_BUFFER);
+    tiles.reserve(size_t(max_x - min_x + 1) * (max_y - min_y + 1));
+    for (uint32_t y = min_y; y <= max_y; ++y) {
+        for (uint32_t x = min_x; x <= max_x; ++x) {
+            tiles.push_back({zoom, x, y});
+        }
+    }
+    return tiles;
+}
+
+template <typename Projection>
+bool Render::RenderArea(const Scene& scene, const Geometry& geometry, const Rect& area, const Rect& canvas,
+                        Projection project_coordinates, svg::Document& doc) const {
+    const auto project = [&scene, &project_coordinates](uint32_t stop) {
+        return project_coordinates(geo::Coordinates{scene.lats[stop], scene.lngs[stop]});
+    };
+    bool has_objects = false;
     
-    // Рендерим названия остановок
-    for (const auto& stop : stops_to_render) {
-        svg::Point point = projector(stop->coordinates);
+    // Линии маршрутов. Отрезки приходят по возрастанию номеров, то есть по маршрутам
+    // в порядке полной карты и по порядку следования внутри маршрута
+    const std::vector<uint32_t> segments = geometry.segments.Query(area);
+    const std::vector<uint32_t>& starts = geometry.segment_starts;
+    std::vector<uint32_t> visible_routes;
+    for (size_t i = 0; i < segments.size();) {
+        const uint32_t route_index = static_cast<uint32_t>(
+            std::upper_bound(starts.begin(), starts.end(), segments[i]) - starts.begin() - 1);
+        const Scene::RouteItem& route = scene.routes[route_index];
+        const std::vector<uint32_t>& line = geometry.routes[route_index];
         
-        // Создаем подложку (background)
-        svg::Text background;
-        background.SetPosition(point);
-        background.SetOffset({settings_.stop_label_offset.dx, settings_.stop_label_offset.dy});
-        background.SetFontSize(settings_.stop_label_font_size);
-        background.SetFontFamily("Verdana");
-        background.SetData(stop->name);
-        background.SetFillColor(ColorToString(settings_.underlayer_color));
-        background.SetStrokeColor(ColorToString(settings_.underlayer_color));
-        background.SetStrokeWidth(settings_.underlayer_width);
-        background.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
-        background.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
-        
-        // Создаем основную надпись
-        svg::Text label;
-        label.SetPosition(point);
-        label.SetOffset({settings_.stop_label_offset.dx, settings_.stop_label_offset.dy});
-        label.SetFontSize(settings_.stop_label_font_size);
-        label.SetFontFamily("Verdana");
-        label.SetData(stop->name);
-        label.SetFillColor("black");
-        
-        // Добавляем в документ (сначала подложку, потом надпись)
-        doc.Add(background);
-        doc.Add(label);
+        // Видимые части идущих подряд отрезков соединяются в одну линию
+        svg::Polyline polyline;
+        bool has_polyline = false;
+        bool visible = false;
+        // Последний отрезок, добавленный в открытую линию
+        uint32_t last_segment = 0;
+        const auto flush = [&]() {
+            if (has_polyline) {
+                AddBusLine(std::move(polyline), route.color, doc);
+                polyline = svg::Polyline();
+                has_polyline = false;
+            }
+        };
+        for (; i < segments.size() && segments[i] < starts[route_index + 1]; ++i) {
+            const uint32_t segment = segments[i] - starts[route_index];
+            const uint32_t from_stop = line[segment];
+            const uint32_t to_stop = line.size() == 1 ? from_stop : line[segment + 1];
+            const svg::Point from = project(from_stop);
+            const svg::Point to = project(to_stop);
+            const auto clipped = ClipSegment(from, to, canvas);
+            if (!clipped) {
+                flush();
+                continue;
+            }
+            visible = true;
+            const auto [t0, t1] = *clipped;
+            if (!has_polyline || last_segment + 1 != segment || t0 != 0.0) {
+                flush();
+                polyline.AddPoint(Interpolate(from, to, t0));
+                has_polyline = true;
+            }
+            if (line.size() != 1) {
+                polyline.AddPoint(Interpolate(from, to, t1));
+            }
+            last_segment = segment;
+            if (t1 != 1.0) {
+                flush();
+            }
+        }
+        flush();
+        if (visible) {
+            visible_routes.push_back(route_index);
+            has_objects = true;
+        }
+    }
+    
+    // Названия маршрутов у конечных остановок на холсте
+    for (const uint32_t route_index : visible_routes) {
+        const Scene::RouteItem& route = scene.routes[route_index];
+        for (const uint32_t stop : route.terminals) {
+            const svg::Point point = project(stop);
+            if (canvas.Contains(point.x, point.y)) {
+                AddBusLabel(point, route.route->name, route.color, scene.underlayer_color, doc);
+            }
+        }
+    }
+    
+    // Остановки на холсте, по названию
+    std::vector<std::pair<uint32_t, svg::Point>> visible_stops;
+    for (const uint32_t item : geometry.stop_index.Query(area)) {
+        const svg::Point point = project(geometry.stops[item]);
+        if (canvas.Contains(point.x, point.y)) {
+            visible_stops.emplace_back(item, point);
+        }
+    }
+    for (const auto& [item, point] : visible_stops) {
+        AddStopSymbol(point, doc);
+    }
+    for (const auto& [item, point] : visible_stops) {
+        if (geometry.labeled[item]) {
+            AddStopLabel(point, scene.stops[geometry.stops[item]]->name, scene.underlayer_color, doc);
+        }
+    }
+    
+    return has_objects || !visible_stops.empty();
+}
+
+void Render::RenderBusLines(const Scene& scene, svg::Document& doc) const {
+    for (const auto& route : scene.routes) {
+        // Создаем полилинию для маршрута
+        svg::Polyline polyline;
+        for (const uint32_t stop : route.stops) {
+            polyline.AddPoint(scene.GetPoint(stop));
+        }
+        AddBusLine(std::move(polyline), route.color, doc);
+    }
+}
+
+void Render::RenderBusLabels(const Scene& scene, svg::Document& doc) const {
+    for (const auto& route : scene.routes) {
+        // Рендерим названия для каждой конечной остановки
+        for (const uint32_t stop : route.terminals) {
+            AddBusLabel(scene.GetPoint(stop), route.route->name, route.color, scene.underlayer_color, doc);
+        }
+    }
+}
+
+void Render::RenderStopSymbols(const Scene& scene, svg::Document& doc) const {
+    for (uint32_t i = 0; i < scene.stops.size(); ++i) {
+        AddStopSymbol(scene.GetPoint(i), doc);
+    }
+}
+
+void Render::RenderStopLabels(const Scene& scene, svg::Document& doc) const {
+    for (uint32_t i = 0; i < scene.stops.size(); ++i) {
+        AddStopLabel(scene.GetPoint(i), scene.stops[i]->name, scene.underlayer_color, doc);
     }
 }
 
-} // namespace map_renderer
\ No newline at end of file
+void Render::AddBusLine(svg::Polyline polyline, const std::string& color, svg::Document& doc) const {
+    // Настраиваем стиль линии согласно требованиям
+    polyline.SetStrokeColor(color);
+    polyline.SetFillColor("none");
+    polyline.SetStrokeWidth(settings_.line_width);
+    polyline.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
+    polyline.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+    
+    doc.Add(std::move(polyline));
+}
+
+void Render::AddBusLabel(svg::Point point, const std::string& name, const std::string& color,
+                         const std::string& underlayer_color, svg::Document& doc) const {
+    // Создаем подложку (background)
+    svg::Text background;
+    background.SetPosition(point);
+    background.SetOffset({settings_.bus_label_offset.dx, settings_.bus_label_offset.dy});
+    background.SetFontSize(settings_.bus_label_font_size);
+    background.SetFontFamily("Verdana");
+    background.SetFontWeight("bold");
+    background.SetData(name);
+    background.SetFillColor(underlayer_color);
+    background.SetStrokeColor(underlayer_color);
+    background.SetStrokeWidth(settings_.underlayer_width);
+    background.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
+    background.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+    
+    // Создаем основную надпись
+    svg::Text label;
+    label.SetPosition(point);
+    label.SetOffset({settings_.bus_label_offset.dx, settings_.bus_label_offset.dy});
+    label.SetFontSize(settings_.bus_label_font_size);
+    label.SetFontFamily("Verdana");
+    label.SetFontWeight("bold");
+    label.SetData(name);
+    label.SetFillColor(color);
+    
+    // Добавляем в документ (сначала подложку, потом надпись)
+    doc.Add(std::move(background));
+    doc.Add(std::move(label));
+}
+
+void Render::AddStopSymbol(svg::Point point, svg::Document& doc) const {
+    svg::Circle circle;
+    circle.SetCenter(point);
+    circle.SetRadius(settings_.stop_radius);
+    circle.SetFillColor("white");
+    
+    doc.Add(std::move(circle));
+}
+
+void Render::AddStopLabel(svg::Point point, const std::string& name, const std::string& underlayer_color,
+                          svg::Document& doc) const {
+    // Создаем подложку (background)
+    svg::Text background;
+    background.SetPosition(point);
+    background.SetOffset({settings_.stop_label_offset.dx, settings_.stop_label_offset.dy});
+    background.SetFontSize(settings_.stop_label_font_size);
+    background.SetFontFamily("Verdana");
+    background.SetData(name);
+    background.SetFillColor(underlayer_color);
+    background.SetStrokeColor(underlayer_color);
+    background.SetStrokeWidth(settings_.underlayer_width);
+    background.SetStrokeLineCap(svg::StrokeLineCap::ROUND);
+    background.SetStrokeLineJoin(svg::StrokeLineJoin::ROUND);
+    
+    // Создаем основную надпись
+    svg::Text label;
+    label.SetPosition(point);
+    label.SetOffset({settings_.stop_label_offset.dx, settings_.stop_label_offset.dy});
+    label.SetFontSize(settings_.stop_label_font_size);
+    label.SetFontFamily("Verdana");
+    label.SetData(name);
+    label.SetFillColor("black");
+    
+    // Добавляем в документ (сначала подложку, потом надпись)
+    doc.Add(std::move(background));
+    doc.Add(std::move(label));
+}
+
+} // namespace map_renderer
@@ -10,9 +10,16 @@
 #include <vector>
 #include <variant>
 #include <algorithm>
+#include <array>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
 #include <optional>
 #include <iostream>
+#include <unordered_map>
 #include "geo.h"
+#include "grid_index.h"
 #include "svg.h"
 #include "transport_catalogue.h"
 
@@ -63,6 +70,10 @@ inline bool IsZero(double value) {
 // Класс для проецирования сферических координат на плоскость
 class SphereProjector {
 public:
+    // Проекция с заданным масштабом: точка (max_lat, min_lon) отображается в (padding, padding)
+    SphereProjector(double min_lon, double max_lat, double zoom_coeff, double padding)
+        : padding_(padding), min_lon_(min_lon), max_lat_(max_lat), zoom_coeff_(zoom_coeff) {}
+    
     // points_begin и points_end задают начало и конец интервала элементов geo::Coordinates
     template <typename PointInputIt>
     SphereProjector(PointInputIt points_begin, PointInputIt points_end,
@@ -120,6 +131,30 @@ public:
             (max_lat_ - coords.lat) * zoom_coeff_ + padding_
         };
     }
+    
+    // Обратная проекция. При нулевом масштабе все точки соответствуют одной
+    geo::Coordinates Unproject(svg::Point point) const {
+        if (IsZero(zoom_coeff_)) {
+            return {max_lat_, min_lon_};
+        }
+        return {
+            max_lat_ - (point.y - padding_) / zoom_coeff_,
+            min_lon_ + (point.x - padding_) / zoom_coeff_
+        };
+    }
+    
+    double GetZoom() const {
+        return zoom_coeff_;
+    }
+    
+    // Проецирует count точек, заданных отдельными массивами широт и долгот.
+    // Итерации независимы и без ветвлений, поэтому компилятор может векторизовать цикл
+    void Project(const double* lats, const double* lngs, size_t count, double* xs, double* ys) const {
+        for (size_t i = 0; i < count; ++i) {
+            xs[i] = (lngs[i] - min_lon_) * zoom_coeff_ + padding_;
+            ys[i] = (max_lat_ - lats[i]) * zoom_coeff_ + padding_;
+        }
+    }
 
 private:
     double padding_;
@@ -128,28 +163,204 @@ private:
     double zoom_coeff_ = 0;
 };
 
+// Часть карты, заданная географическим прямоугольником. Он вписывается в холст
+// так же, как вся сеть на полной карте
+struct ViewportBounds {
+    geo::Coordinates min;
+    geo::Coordinates max;
+};
+
+// Часть карты вокруг точки. Масштаб 1 соответствует полной карте, 2 - вдвое крупнее
+struct ViewportCenter {
+    geo::Coordinates center;
+    double zoom = 1.0;
+};
+
+// Видимая часть карты для запроса Map
+using Viewport = std::variant<ViewportBounds, ViewportCenter>;
+
+// Наибольший поддерживаемый уровень плиток
+inline const int MAX_TILE_ZOOM = 24;
+
+// Плитка карты в схеме XYZ (Web Mercator): уровень z, столбец x и строка y от северо-западного угла
+struct TileId {
+    int z = 0;
+    uint32_t x = 0;
+    uint32_t y = 0;
+
+    // Плитка существует: уровень от 0 до MAX_TILE_ZOOM, x и y меньше 2^z
+    bool IsValid() const {
+        return z >= 0 && z <= MAX_TILE_ZOOM && x < (uint32_t{1} << z) && y < (uint32_t{1} << z);
+    }
+};
+
+// Размер плитки в точках
+inline const double TILE_SIZE = 256.0;
+
+// Отрисованная карта: SVG и он же в виде строки JSON (в кавычках, с экранированием)
+struct RenderedMap {
+    uint64_t catalogue_version = 0;
+    std::string svg;
+    std::string json;
+};
+
 // Класс для рендеринга карты
 class Render {
 public:
-    explicit Render(const RenderSettings& settings) : settings_(settings) {}
+    explicit Render(const RenderSettings& settings);
     
     // Основной метод рендеринга
     void RenderMap(const transport_catalogue::TransportCatalogue& catalogue, std::ostream& out) const;
     
+    // Карта каталога из кэша. Кэш общий для всех копий Render и действителен, пока не изменились
+    // каталог (его GetVersion) и настройки (у нового Render свой кэш). Одновременные запросы
+    // одной и той же карты отрисовывают её один раз
+    std::shared_ptr<const RenderedMap> GetMap(const transport_catalogue::TransportCatalogue& catalogue) const;
+    
+    // Отрисовывает часть карты на холсте того же размера. Выводятся только объекты, попавшие
+    // на холст, линии маршрутов обрезаются по его краю. Порядок и цвета объектов те же,
+    // что на полной карте. Детализация зависит от масштаба так же, как у плиток: линии
+    // упрощены, остановки и названия прорежены. Объекты выбираются по пространственным
+    // индексам, которые строятся один раз для версии каталога и масштаба
+    void RenderMap(const transport_catalogue::TransportCatalogue& catalogue, const Viewport& viewport,
+                   std::ostream& out) const;
+    
+    // Отрисовывает плитку 256x256 в проекции Web Mercator со стилем из настроек. Объекты соседних
+    // плиток, заходящие на эту, отрисовываются и на ней, поэтому плитки стыкуются без разрывов.
+    // Результат зависит только от каталога, настроек и плитки. Возвращает false, если плитка пуста.
+    // Бросает std::invalid_argument, если плитки нет на уровне
+    bool RenderTile(const transport_catalogue::TransportCatalogue& catalogue, const TileId& tile,
+                    std::ostream& out) const;
+    
+    // Плитка из кэша LRU, общего для всех копий Render. При изменении каталога кэш очищается
+    std::shared_ptr<const RenderedMap> GetTile(const transport_catalogue::TransportCatalogue& catalogue,
+                                               const TileId& tile) const;
+    
+    // Плитки уровня zoom, на которые попадает сеть, по строкам сверху вниз и по столбцам слева направо
+    std::vector<TileId> GetTiles(const transport_catalogue::TransportCatalogue& catalogue, int zoom) const;
+    
 private:
+    // Подготовленная сцена: всё, что нужно слоям карты, вычисляется один раз за отрисовку
+    struct Scene {
+        struct RouteItem {
+            const Route* route;
+            std::string color;
+            // Индексы остановок маршрута в stops по порядку следования
+            std::vector<uint32_t> stops;
+            // Индексы конечных остановок, у которых выводится название маршрута
+            std::vector<uint32_t> terminals;
+        };
+        
+        // Непустые маршруты по названию
+        std::vector<RouteItem> routes;
+        // Остановки, через которые проходят маршруты, по названию.
+        // Каждая проецируется один раз: её точка на карте - (xs[i], ys[i]), координаты - (lats[i], lngs[i])
+        std::vector<const Stop*> stops;
+        std::vector<double> lats;
+        std::vector<double> lngs;
+        std::vector<double> xs;
+        std::vector<double> ys;
+        // Проекция полной карты
+        SphereProjector projector{0.0, 0.0, 0.0, 0.0};
+        std::string underlayer_color;
+        
+        svg::Point GetPoint(uint32_t index) const {
+            return {xs[index], ys[index]};
+        }
+    };
+    
+    // Линии маршрутов и остановки сцены с индексами для отрисовки части карты (долгота - x, широта - y)
+    struct Geometry {
+        // Вершины линии маршрута i сцены - индексы остановок
+        std::vector<std::vector<uint32_t>> routes;
+        // Отрезки линии маршрута i - номера segment_starts[i]..segment_starts[i + 1]; отрезок k
+        // соединяет её вершины k и k + 1. У линии из одной вершины один отрезок нулевой длины
+        GridIndex segments;
+        std::vector<uint32_t> segment_starts;
+        // Отображаемые остановки по названию; объект i индекса stop_index - остановка stops[i]
+        std::vector<uint32_t> stops;
+        GridIndex stop_index;
+        // Выводится ли название остановки stops[i]
+        std::vector<bool> labeled;
+    };
+    
+    // Сцена с полной геометрией и упрощёнными геометриями уровней плиток и частей карты
+    struct IndexedScene {
+        uint64_t catalogue_version = 0;
+        Scene scene;
+        Geometry geometry;
+        // Геометрия уровня строится при первой плитке или части карты этого уровня.
+        // Уровень части карты z (от -MAX_TILE_ZOOM до MAX_TILE_ZOOM) - масштаб полной карты,
+        // умноженный на 2^z, хранится под номером z + MAX_TILE_ZOOM
+        mutable std::mutex levels_mutex;
+        mutable std::array<std::shared_ptr<const Geometry>, MAX_TILE_ZOOM + 1> levels;
+        mutable std::array<std::shared_ptr<const Geometry>, 2 * MAX_TILE_ZOOM + 1> viewport_levels;
+    };
+    
     // Вспомогательные методы
     std::string ColorToString(const Color& color) const;
-    void RenderBusLines(const transport_catalogue::TransportCatalogue& catalogue, 
-                       const SphereProjector& projector, svg::Document& doc) const;
-    void RenderBusLabels(const transport_catalogue::TransportCatalogue& catalogue,
-                        const SphereProjector& projector, svg::Document& doc) const;
-    void RenderStopSymbols(const transport_catalogue::TransportCatalogue& catalogue,
-                          const SphereProjector& projector, svg::Document& doc) const;
-    void RenderStopLabels(const transport_catalogue::TransportCatalogue& catalogue,
-                         const SphereProjector& projector, svg::Document& doc) const;
+    // Возвращает пустую сцену, если у используемых остановок нет координат
+    Scene PrepareScene(const transport_catalogue::TransportCatalogue& catalogue) const;
+    // Сцена с индексами из кэша, по тем же правилам, что и GetMap
+    std::shared_ptr<const IndexedScene> GetIndexedScene(const transport_catalogue::TransportCatalogue& catalogue) const;
+    SphereProjector MakeProjector(const Scene& scene, const Viewport& viewport) const;
+    static Geometry MakeGeometry(const Scene& scene, std::vector<std::vector<uint32_t>> routes,
+                                 std::vector<uint32_t> stops, std::vector<bool> labeled);
+    // Геометрия уровня плиток zoom: линии маршрутов упрощены с допуском в точку уровня,
+    // остановки и их названия прорежены по сетке так, чтобы не перекрывать друг друга
+    std::shared_ptr<const Geometry> GetLevelGeometry(const IndexedScene& indexed, int zoom) const;
+    // Геометрия части карты с масштабом проекции zoom_coeff, упрощённая так же в точках
+    // холста. nullptr, если при таком увеличении нужна полная геометрия
+    std::shared_ptr<const Geometry> GetViewportGeometry(const IndexedScene& indexed, double zoom_coeff) const;
+    // Упрощение и прореживание по точкам остановок сцены на холсте уровня
+    Geometry MakeLevelGeometry(const Scene& scene, const std::vector<svg::Point>& points) const;
+    
+    // Отрисовывает объекты, попавшие на холст canvas: area - его географическая область
+    // (долгота - x, широта - y), project - проекция координат на холст.
+    // Возвращает false, если на холст ничего не попало
+    template <typename Projection>
+    bool RenderArea(const Scene& scene, const Geometry& geometry, const Rect& area, const Rect& canvas,
+                    Projection project, svg::Document& doc) const;
+    
+    // Элементы слоёв
+    void AddBusLine(svg::Polyline polyline, const std::string& color, svg::Document& doc) const;
+    void AddBusLabel(svg::Point point, const std::string& name, const std::string& color,
+                     const std::string& underlayer_color, svg::Document& doc) const;
+    void AddStopSymbol(svg::Point point, svg::Document& doc) const;
+    void AddStopLabel(svg::Point point, const std::string& name, const std::string& underlayer_color,
+                      svg::Document& doc) const;
+    
+    void RenderBusLines(const Scene& scene, svg::Document& doc) const;
+    void RenderBusLabels(const Scene& scene, svg::Document& doc) const;
+    void RenderStopSymbols(const Scene& scene, svg::Document& doc) const;
+    void RenderStopLabels(const Scene& scene, svg::Document& doc) const;
     
 private:
+    struct MapCache {
+        std::mutex mutex;
+        std::shared_ptr<const RenderedMap> map;
+        std::shared_ptr<const IndexedScene> indexed_scene;
+    };
+    
+    // Плитки одной версии каталога. Самые давние по использованию вытесняются,
+    // когда общий размер превышает предел
+    struct TileCache {
+        struct Entry {
+            uint64_t key;
+            std::shared_ptr<const RenderedMap> tile;
+        };
+        
+        std::mutex mutex;
+        uint64_t catalogue_version = 0;
+        size_t size = 0;
+        // В начале - последние использованные
+        std::list<Entry> entries;
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> positions;
+    };
+    
     RenderSettings settings_;
+    std::shared_ptr<MapCache> cache_;
+    std::shared_ptr<TileCache> tiles_;
 };
 
 } // namespace map_renderer
\ No newline at end of file
@@ -0,0 +1,120 @@
+#pragma once
+
+/*
+ * Вспомогательные средства для параллельных этапов обработки.
+ * Работа делится на непрерывные диапазоны, каждый из которых обрабатывается в своём потоке,
+ * поэтому результат не зависит от числа потоков и порядка их завершения.
+ */
+
+#include <algorithm>
+#include <cstddef>
+#include <exception>
+#include <thread>
+#include <vector>
+
+namespace parallel
+{
+
+    // Число потоков для параллельных этапов по умолчанию
+    inline size_t DefaultThreadCount()
+    {
+        const unsigned hardware = std::thread::hardware_concurrency();
+        return hardware == 0 ? 1 : hardware;
+    }
+
+    // Делит диапазон [0, count) на не более чем thread_count непрерывных частей и вызывает
+    // func(chunk_index, begin, end) для каждой из них в отдельном потоке.
+    // Возвращает число частей. Первое исключение, выброшенное в потоках, пробрасывается после их завершения
+    template <typename Func>
+    size_t ForEachChunk(size_t count, size_t thread_count, Func func)
+    {
+        const size_t chunk_count = std::max<size_t>(1, std::min(thread_count, count));
+        if (chunk_count == 1)
+        {
+            func(size_t{0}, size_t{0}, count);
+            return 1;
+        }
+
+        const size_t chunk_size = (count + chunk_count - 1) / chunk_count;
+        std::vector<std::exception_ptr> errors(chunk_count);
+        std::vector<std::thread> workers;
+        workers.reserve(chunk_count);
+
+        for (size_t chunk = 0; chunk < chunk_count; ++chunk)
+        {
+            const size_t begin = std::min(count, chunk * chunk_size);
+            const size_t end = std::min(count, begin + chunk_size);
+            workers.emplace_back([&func, &errors, chunk, begin, end]
+                                 {
+                                     try
+                                     {
+                                         func(chunk, begin, end);
+                                     }
+                                     catch (...)
+                                     {
+                                         errors[chunk] = std::current_exception();
+                                     } });
+        }
+
+        for (std::thread &worker : workers)
+        {
+            worker.join();
+        }
+        for (const std::exception_ptr &error : errors)
+        {
+            if (error)
+            {
+                std::rethrow_exception(error);
+            }
+        }
+        return chunk_count;
+    }
+
+    // Число потоков, при котором на каждый приходится не меньше min_per_thread элементов
+    inline size_t ThreadsFor(size_t count, size_t thread_count, size_t min_per_thread)
+    {
+        return std::max<size_t>(1, std::min(thread_count, count / std::max<size_t>(1, min_per_thread)));
+    }
+
+    // Сортирует items в thread_count потоках: части сортируются независимо,
+    // затем попарно сливаются, на каждом уровне слияния - параллельно.
+    // Результат совпадает с std::sort для любого строгого порядка comp без равных элементов
+    template <typename T, typename Compare>
+    void Sort(std::vector<T> &items, size_t thread_count, Compare comp)
+    {
+        constexpr size_t MIN_ITEMS_PER_THREAD = 4096;
+        const size_t count = items.size();
+        thread_count = ThreadsFor(count, thread_count, MIN_ITEMS_PER_THREAD);
+        if (thread_count == 1)
+        {
+            std::sort(items.begin(), items.end(), comp);
+            return;
+        }
+
+        const size_t chunk_size = (count + thread_count - 1) / thread_count;
+        auto at = [&items, count](size_t index)
+        {
+            return items.begin() + std::min(count, index);
+        };
+
+        ForEachChunk(thread_count, thread_count, [&](size_t, size_t begin, size_t end)
+                     {
+                         for (size_t chunk = begin; chunk < end; ++chunk)
+                         {
+                             std::sort(at(chunk * chunk_size), at((chunk + 1) * chunk_size), comp);
+                         } });
+
+        for (size_t width = chunk_size; width < count; width *= 2)
+        {
+            const size_t merge_count = (count + 2 * width - 1) / (2 * width);
+            ForEachChunk(merge_count, thread_count, [&](size_t, size_t begin, size_t end)
+                         {
+                             for (size_t merge = begin; merge < end; ++merge)
+                             {
+                                 const size_t first = merge * 2 * width;
+                                 std::inplace_merge(at(first), at(first + width), at(first + 2 * width), comp);
+                             } });
+        }
+    }
+
+} // namespace parallel
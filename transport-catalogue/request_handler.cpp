@@ -1,9 +1,14 @@
 #include "request_handler.h"
 #include "json_builder.h"
+#include "parallel.h"
 #include <sstream>
 #include <stdexcept>
 #include <iostream>
 #include <algorithm>
+#include <deque>
+#include <future>
+#include <iterator>
+#include <optional>
 
 #ifdef DEBUG_PRINT
 #undef DEBUG_PRINT
@@ -37,6 +42,73 @@ namespace request_handler
         return it->second(request_dict, renderer);
     }
 
+    namespace
+    {
+        // Массив из count чисел в поле field_name
+        std::vector<double> GetNumbers(const json::Node &node, const std::string &field_name, size_t count)
+        {
+            if (!node.IsArray() || node.AsArray().size() != count)
+            {
+                throw json::ParsingError("Field '" + field_name + "' must be an array of " + std::to_string(count) + " numbers");
+            }
+            std::vector<double> numbers;
+            for (const json::Node &item : node.AsArray())
+            {
+                if (!item.IsDouble())
+                {
+                    throw json::ParsingError("Field '" + field_name + "' must be an array of " + std::to_string(count) + " numbers");
+                }
+                numbers.push_back(item.AsDouble());
+            }
+            return numbers;
+        }
+
+        // Видимая часть карты: "bbox": [min_lat, min_lng, max_lat, max_lng]
+        // или "center": [lat, lng] с необязательным "zoom"
+        std::optional<map_renderer::Viewport> ParseViewport(const json::Dict &request_dict)
+        {
+            const auto bbox_it = request_dict.find("bbox");
+            const auto center_it = request_dict.find("center");
+            const auto zoom_it = request_dict.find("zoom");
+
+            if (bbox_it != request_dict.end())
+            {
+                if (center_it != request_dict.end() || zoom_it != request_dict.end())
+                {
+                    throw json::ParsingError("Map request accepts either 'bbox' or 'center' and 'zoom'");
+                }
+                const std::vector<double> bbox = GetNumbers(bbox_it->second, "bbox", 4);
+                if (!(bbox[0] < bbox[2]) || !(bbox[1] < bbox[3]))
+                {
+                    throw json::ParsingError("Field 'bbox' must be [min_lat, min_lng, max_lat, max_lng]");
+                }
+                return map_renderer::ViewportBounds{{bbox[0], bbox[1]}, {bbox[2], bbox[3]}};
+            }
+
+            if (center_it == request_dict.end())
+            {
+                if (zoom_it != request_dict.end())
+                {
+                    throw json::ParsingError("Field 'zoom' requires 'center'");
+                }
+                return std::nullopt;
+            }
+
+            const std::vector<double> center = GetNumbers(center_it->second, "center", 2);
+            map_renderer::ViewportCenter viewport{{center[0], center[1]}};
+            if (zoom_it != request_dict.end())
+            {
+                if (!zoom_it->second.IsDouble() || !(zoom_it->second.AsDouble() > 0.0))
+                {
+                    throw json::ParsingError("Field 'zoom' must be a positive number");
+                }
+                viewport.zoom = zoom_it->second.AsDouble();
+            }
+            return viewport;
+        }
+
+    } // namespace
+
     // Реализация RequestFactory
     std::unique_ptr<Request> RequestFactory::CreateStopRequest(const json::Dict &request_dict, const map_renderer::Render &renderer)
     {
@@ -57,88 +129,293 @@ namespace request_handler
     std::unique_ptr<Request> RequestFactory::CreateMapRequest(const json::Dict &request_dict, const map_renderer::Render &renderer)
     {
         int id = json::GetIntValue(request_dict, "id");
-        return std::make_unique<MapRequest>(id, renderer);
+        return std::make_unique<MapRequest>(id, renderer, ParseViewport(request_dict));
     }
 
-    // Реализация конкретных запросов
-    json::Node StopRequest::Execute(const transport_catalogue::TransportCatalogue &catalogue) const
+    std::unique_ptr<Request> RequestFactory::CreateTileRequest(const json::Dict &request_dict, const map_renderer::Render &renderer)
     {
-        DEBUG_PRINT("Executing Stop request for: " << name_ << " (id: " << id_ << ")");
+        int id = json::GetIntValue(request_dict, "id");
+        const int z = json::GetIntValue(request_dict, "z");
+        const int x = json::GetIntValue(request_dict, "x");
+        const int y = json::GetIntValue(request_dict, "y");
+        // Отрицательные x и y после приведения больше любого допустимого номера
+        const map_renderer::TileId tile{z, static_cast<uint32_t>(x), static_cast<uint32_t>(y)};
+        if (!tile.IsValid())
+        {
+            throw json::ParsingError("Tile " + std::to_string(z) + "/" + std::to_string(x) + "/" + std::to_string(y) + " does not exist");
+        }
+        return std::make_unique<TileRequest>(id, renderer, tile);
+    }
+
+    namespace
+    {
+        // Число запросов, разбираемых параллельно за один раз
+        constexpr size_t STAT_REQUESTS_PARSE_BATCH = 4096;
+
+        // Наименьшая часть пакета, разбираемая одной задачей пула
+        constexpr size_t MIN_PARSE_PART = 256;
+
+        // Разбирает элементы массива пакетами по STAT_REQUESTS_PARSE_BATCH в пуле потоков.
+        // Следующий пакет разбирается, пока вызывающий код обрабатывает текущий
+        class BatchParser
+        {
+        public:
+            BatchParser(const std::vector<json::LazyNode> &elements, parallel::ThreadPool &pool)
+                : elements_(elements), pool_(pool)
+            {
+                Schedule();
+            }
+
+            BatchParser(const BatchParser &) = delete;
+            BatchParser &operator=(const BatchParser &) = delete;
+
+            // Задачи ссылаются на элементы, поэтому их нужно дождаться, даже если разбор прерван
+            ~BatchParser()
+            {
+                for (const std::future<json::Array> &part : next_parts_)
+                {
+                    if (part.valid())
+                    {
+                        part.wait();
+                    }
+                }
+            }
+
+            // Очередной разобранный элемент или nullptr, если элементы закончились.
+            // Указатель действителен до следующего вызова
+            const json::Node *Next()
+            {
+                if (index_ == current_.size())
+                {
+                    if (next_parts_.empty())
+                    {
+                        return nullptr;
+                    }
+                    current_.clear();
+                    index_ = 0;
+                    for (std::future<json::Array> &part : next_parts_)
+                    {
+                        json::Array nodes = part.get();
+                        std::move(nodes.begin(), nodes.end(), std::back_inserter(current_));
+                    }
+                    next_parts_.clear();
+                    Schedule();
+                }
+                return &current_[index_++];
+            }
+
+        private:
+            // Ставит в очередь разбор следующего пакета частями, по одной на поток пула
+            void Schedule()
+            {
+                const size_t begin = next_begin_;
+                const size_t count = std::min(STAT_REQUESTS_PARSE_BATCH, elements_.size() - begin);
+                next_begin_ += count;
+                if (count == 0)
+                {
+                    return;
+                }
+                const size_t part_count = std::clamp<size_t>(count / MIN_PARSE_PART, 1, pool_.GetThreadCount());
+                for (size_t part = 0; part < part_count; ++part)
+                {
+                    const json::LazyNode *first = elements_.data() + begin + count * part / part_count;
+                    const json::LazyNode *last = elements_.data() + begin + count * (part + 1) / part_count;
+                    next_parts_.push_back(pool_.Submit([first, last]
+                                                       {
+                                                           json::Array nodes;
+                                                           nodes.reserve(last - first);
+                                                           for (const json::LazyNode *element = first; element != last; ++element)
+                                                           {
+                                                               nodes.push_back(element->Parse());
+                                                           }
+                                                           return nodes; }));
+                }
+            }
+
+            const std::vector<json::LazyNode> &elements_;
+            parallel::ThreadPool &pool_;
+            size_t next_begin_ = 0;
+            std::vector<std::future<json::Array>> next_parts_;
+            json::Array current_;
+            size_t index_ = 0;
+        };
 
-        const Stop *stop = catalogue.GetStopByName(name_);
+        // Число одновременно выполняемых запросов на поток: ограничивает память
+        // под ещё не выведенные ответы, но позволяет дешёвым запросам обгонять долгие
+        constexpr size_t IN_FLIGHT_PER_THREAD = 4;
 
-        if (!stop)
+        // Ответ об ошибке в том же виде, что и json::CreateErrorResponse
+        void WriteErrorResponse(json::StreamBuilder &builder, int request_id, std::string_view error_message)
         {
-            return json::CreateErrorResponse(id_, "not found");
+            builder.StartDict()
+                .Key("error_message")
+                .Value(error_message)
+                .Key("request_id")
+                .Value(request_id)
+                .EndDict();
         }
 
-        std::vector<std::string> buses = catalogue.GetStopInfo(name_);
+        // Ответ на запрос, который не удалось создать. request_id выводится, если он есть в запросе
+        void WriteInvalidRequestResponse(json::StreamBuilder &builder, const json::Node &request, std::string_view error_message)
+        {
+            std::optional<int> request_id;
+            if (request.IsDict())
+            {
+                const auto id_it = request.AsDict().find("id");
+                if (id_it != request.AsDict().end() && id_it->second.IsInt())
+                {
+                    request_id = id_it->second.AsInt();
+                }
+            }
 
-        auto builder = json::Builder{};
-        builder.StartDict();
-        builder.Key("buses").StartArray();
-        for (const std::string &bus_name : buses)
+            builder.StartDict().Key("error_message").Value(error_message);
+            if (request_id)
+            {
+                builder.Key("request_id").Value(*request_id);
+            }
+            builder.EndDict();
+        }
+    } // namespace
+
+    // Реализация конкретных запросов
+    void StopRequest::ExecuteTo(const transport_catalogue::TransportCatalogue &catalogue, json::StreamBuilder &builder) const
+    {
+        DEBUG_PRINT("Executing Stop request for: " << name_ << " (id: " << id_ << ")");
+
+        if (!catalogue.StopExists(name_))
         {
-            builder.Value(bus_name);
+            WriteErrorResponse(builder, id_, "not found");
+            return;
         }
-        builder.EndArray();
-        auto data = builder.EndDict().Build();
 
-        return json::CreateSuccessResponse(id_, data.AsDict());
+        // Ключи выводятся в том же порядке, что и при печати json::Dict
+        auto buses = builder.StartDict().Key("buses").StartArray();
+        catalogue.ForEachBusByStop(name_, [&buses](std::string_view bus_name)
+                                   { buses.Value(bus_name); });
+        buses.EndArray();
+        builder.Key("request_id").Value(id_);
+        builder.EndDict();
     }
 
-    json::Node BusRequest::Execute(const transport_catalogue::TransportCatalogue &catalogue) const
+    void BusRequest::ExecuteTo(const transport_catalogue::TransportCatalogue &catalogue, json::StreamBuilder &builder) const
     {
         DEBUG_PRINT("Executing Bus request for: " << name_ << " (id: " << id_ << ")");
 
         if (!catalogue.RouteExists(name_))
         {
-            return json::CreateErrorResponse(id_, "not found");
+            WriteErrorResponse(builder, id_, "not found");
+            return;
         }
 
         transport_catalogue::RouteInfo route_info = catalogue.GetRouteInfo(name_);
 
-        auto data = json::Builder{}
-                        .StartDict()
-                        .Key("route_length")
-                        .Value(static_cast<int>(route_info.route_length))
-                        .Key("curvature")
-                        .Value(route_info.curvature)
-                        .Key("stop_count")
-                        .Value(route_info.stops_count)
-                        .Key("unique_stop_count")
-                        .Value(route_info.unique_stops_count)
-                        .EndDict()
-                        .Build();
-
-        return json::CreateSuccessResponse(id_, data.AsDict());
+        // Ключи выводятся в том же порядке, что и при печати json::Dict
+        builder.StartDict()
+            .Key("curvature")
+            .Value(route_info.curvature)
+            .Key("request_id")
+            .Value(id_)
+            .Key("route_length")
+            .Value(static_cast<int>(route_info.route_length))
+            .Key("stop_count")
+            .Value(route_info.stops_count)
+            .Key("unique_stop_count")
+            .Value(route_info.unique_stops_count)
+            .EndDict();
     }
 
-    json::Node MapRequest::Execute(const transport_catalogue::TransportCatalogue &catalogue) const
+    void MapRequest::ExecuteTo(const transport_catalogue::TransportCatalogue &catalogue, json::StreamBuilder &builder) const
     {
         DEBUG_PRINT("Executing Map request (id: " << id_ << ")");
 
-        std::ostringstream svg_stream;
-        renderer_.RenderMap(catalogue, svg_stream);
-        std::string svg_content = svg_stream.str();
+        builder.StartDict().Key("map");
+        if (viewport_)
+        {
+            builder.Value(RenderViewport(catalogue));
+        }
+        else
+        {
+            // Повторный запрос карты неизменённого каталога - копирование готовой строки JSON
+            builder.RawValue(renderer_.GetMap(catalogue)->json);
+        }
+        builder.Key("request_id")
+            .Value(id_)
+            .EndDict();
+    }
 
-        auto data = json::Builder{}
-                        .StartDict()
-                        .Key("map")
-                        .Value(svg_content)
-                        .EndDict()
-                        .Build();
+    void TileRequest::ExecuteTo(const transport_catalogue::TransportCatalogue &catalogue, json::StreamBuilder &builder) const
+    {
+        DEBUG_PRINT("Executing Tile request (id: " << id_ << ")");
+
+        builder.StartDict()
+            .Key("tile")
+            .RawValue(renderer_.GetTile(catalogue, tile_)->json)
+            .Key("request_id")
+            .Value(id_)
+            .EndDict();
+    }
 
-        return json::CreateSuccessResponse(id_, data.AsDict());
+    std::string MapRequest::RenderViewport(const transport_catalogue::TransportCatalogue &catalogue) const
+    {
+        std::ostringstream svg_stream;
+        renderer_.RenderMap(catalogue, *viewport_, svg_stream);
+        return std::move(svg_stream).str();
     }
 
     // Реализация RequestHandler
-    RequestHandler::RequestHandler(transport_catalogue::TransportCatalogue &catalogue)
-        : catalogue_(catalogue), json_reader_(catalogue), renderer_(json_reader_.GetRenderSettings())
+    RequestHandler::RequestHandler(transport_catalogue::TransportCatalogue &catalogue, std::ostream &output)
+        : catalogue_(catalogue), output_(output), json_reader_(catalogue), renderer_(json_reader_.GetRenderSettings()),
+          thread_count_(parallel::DefaultThreadCount())
     {
         RegisterRequestTypes();
     }
 
+    void RequestHandler::SetThreadCount(size_t thread_count)
+    {
+        thread_count_ = std::max<size_t>(1, thread_count);
+        pool_.reset();
+    }
+
+    void RequestHandler::UseVersions(transport_catalogue::VersionedCatalogue &versions)
+    {
+        versions_ = &versions;
+    }
+
+    const map_renderer::RenderSettings &RequestHandler::GetRenderSettings()
+    {
+        PrepareRenderer();
+        return json_reader_.GetRenderSettings();
+    }
+
+    void RequestHandler::SetRenderSettings(const map_renderer::RenderSettings &settings)
+    {
+        renderer_ = map_renderer::Render(settings);
+    }
+
+    RequestHandler::Snapshot RequestHandler::AcquireCatalogue() const
+    {
+        if (versions_)
+        {
+            return versions_->Acquire();
+        }
+        // Невладеющий указатель на собственный каталог
+        return Snapshot(Snapshot(), &catalogue_);
+    }
+
+    uint64_t RequestHandler::ApplyUpdate(const json::Node &base_requests)
+    {
+        if (!versions_)
+        {
+            throw std::logic_error("Catalogue updates require a versioned catalogue");
+        }
+        const size_t thread_count = thread_count_;
+        return versions_->Update([&base_requests](transport_catalogue::TransportCatalogue &catalogue)
+                                 {
+                                     json_reader::JsonReader reader(catalogue);
+                                     reader.ProcessBaseRequestsOptimized(base_requests); },
+                                 thread_count);
+    }
+
     void RequestHandler::ProcessDocument(const json::Document &document)
     {
         DEBUG_PRINT("Processing document for data loading...");
@@ -172,14 +449,139 @@ namespace request_handler
         return json::Document(json::Node(json::Dict{}));
     }
 
+    void RequestHandler::ProcessRequestLine(std::string_view line)
+    {
+        std::string response = AnswerRequestLine(line);
+        response.push_back('\n');
+        output_ << response;
+        output_.flush();
+    }
+
+    std::string RequestHandler::AnswerRequestLine(std::string_view line)
+    {
+        json::PrintOptions options;
+        options.compact = true;
+
+        // Ответ собирается целиком, чтобы при ошибке в середине пакета
+        // в вывод не попала незавершённая строка
+        std::ostringstream response;
+        try
+        {
+            const json::Node root = json::Load(line).ReleaseRoot();
+            const json::Node *requests = &root;
+            std::optional<uint64_t> version;
+            if (root.IsDict())
+            {
+                const json::Dict &root_dict = root.AsDict();
+                if (auto it = root_dict.find("base_requests"); it != root_dict.end())
+                {
+                    // Обновление публикуется до выполнения stat_requests той же строки
+                    version = ApplyUpdate(it->second);
+                    requests = nullptr;
+                }
+                if (auto it = root_dict.find("stat_requests"); it != root_dict.end())
+                {
+                    requests = &it->second;
+                }
+            }
+
+            const Snapshot catalogue = AcquireCatalogue();
+            if (!requests)
+            {
+                // Обновление без запросов: ответом служит номер опубликованной версии
+                json::StreamBuilder builder(response, options);
+                builder.StartDict().Key("version").Value(static_cast<int>(*version)).EndDict();
+            }
+            else if (requests->IsArray())
+            {
+                json::ArrayWriter writer(response, options);
+                WriteResponses(requests->AsArray(), writer, catalogue);
+                writer.Finish();
+            }
+            else if (requests->IsDict())
+            {
+                json::StreamBuilder builder(response, options);
+                std::unique_ptr<Request> single_request;
+                try
+                {
+                    single_request = CreateRequest(*requests);
+                }
+                catch (const std::exception &e)
+                {
+                    // Как и в пакете, request_id выводится, если он есть в запросе
+                    WriteInvalidRequestResponse(builder, *requests, e.what());
+                }
+                if (single_request)
+                {
+                    single_request->ExecuteTo(*catalogue, builder);
+                }
+                builder.Finish();
+            }
+            else
+            {
+                throw json::ParsingError("Request line must contain a dictionary or an array");
+            }
+        }
+        catch (const std::exception &e)
+        {
+            DEBUG_PRINT("Failed to process request line: " << e.what());
+            response.str({});
+            json::StreamBuilder builder(response, options);
+            builder.StartDict().Key("error_message").Value(e.what()).EndDict();
+        }
+
+        return std::move(response).str();
+    }
+
     void RequestHandler::RegisterRequestTypes()
     {
         request_registry_.Register("Stop", RequestFactory::CreateStopRequest);
         request_registry_.Register("Bus", RequestFactory::CreateBusRequest);
         request_registry_.Register("Map", RequestFactory::CreateMapRequest);
+        request_registry_.Register("Tile", RequestFactory::CreateTileRequest);
+    }
+
+    void RequestHandler::ProcessDocument(const json::LazyDocument &document)
+    {
+        DEBUG_PRINT("Processing lazy document for data loading...");
+        json_reader_.ProcessDocument(document);
     }
 
-    json::Node RequestHandler::ProcessSingleRequest(const json::Dict &request_dict)
+    void RequestHandler::ProcessRequests(const json::LazyDocument &document)
+    {
+        DEBUG_PRINT("Processing requests from lazy document...");
+
+        const json::LazyNode &root = document.GetRoot();
+        if (!root.IsDict())
+        {
+            throw json::ParsingError("Root node must be a dictionary");
+        }
+
+        if (auto stat_requests = root.Find("stat_requests"))
+        {
+            ProcessStatRequests(*stat_requests);
+        }
+    }
+
+    void RequestHandler::PrepareRenderer()
+    {
+        if (json_reader_.ResolveRenderSettings())
+        {
+            renderer_ = map_renderer::Render(json_reader_.GetRenderSettings());
+            DEBUG_PRINT("Renderer updated with deferred settings");
+        }
+    }
+
+    std::unique_ptr<Request> RequestHandler::CreateRequest(const json::Node &request)
+    {
+        if (!request.IsDict())
+        {
+            throw json::ParsingError("Request must be a dictionary");
+        }
+        return CreateRequest(request.AsMap());
+    }
+
+    std::unique_ptr<Request> RequestHandler::CreateRequest(const json::Dict &request_dict)
     {
         auto type_it = request_dict.find("type");
         if (type_it == request_dict.end() || !type_it->second.IsString())
@@ -187,9 +589,136 @@ namespace request_handler
             throw json::ParsingError("Request must have 'type' field as string");
         }
 
-        std::string type = type_it->second.AsString();
-        auto request = request_registry_.Create(type, request_dict, renderer_);
-        return request->Execute(catalogue_);
+        const std::string &type = type_it->second.AsString();
+        if (type == "Map" || type == "Tile")
+        {
+            PrepareRenderer();
+        }
+        return request_registry_.Create(type, request_dict, renderer_);
+    }
+
+    void RequestHandler::WriteResponse(const json::Node &request, json::ArrayWriter &writer,
+                                       const transport_catalogue::TransportCatalogue &catalogue)
+    {
+        // Ответ сериализуется прямо в выходной поток, без промежуточного json::Node
+        std::unique_ptr<Request> single_request;
+        try
+        {
+            single_request = CreateRequest(request);
+        }
+        catch (const std::exception &e)
+        {
+            // Ошибка в запросе не прерывает пакет: вместо ответа выводится сообщение об ошибке
+            json::StreamBuilder builder(writer.BeginElement(), writer.GetOptions(), writer.GetElementIndent());
+            WriteInvalidRequestResponse(builder, request, e.what());
+            builder.Finish();
+            return;
+        }
+        json::StreamBuilder builder(writer.BeginElement(), writer.GetOptions(), writer.GetElementIndent());
+        single_request->ExecuteTo(catalogue, builder);
+        builder.Finish();
+    }
+
+    parallel::ThreadPool &RequestHandler::GetPool()
+    {
+        if (!pool_)
+        {
+            pool_ = std::make_unique<parallel::ThreadPool>(thread_count_);
+        }
+        return *pool_;
+    }
+
+    void RequestHandler::WriteResponses(const json::Array &requests, json::ArrayWriter &writer, const Snapshot &catalogue)
+    {
+        if (thread_count_ < 2 || requests.size() < 2)
+        {
+            for (const json::Node &request : requests)
+            {
+                WriteResponse(request, writer, *catalogue);
+            }
+            return;
+        }
+
+        size_t next = 0;
+        WriteResponses([&requests, &next]
+                       { return next < requests.size() ? &requests[next++] : nullptr; },
+                       writer, catalogue);
+    }
+
+    void RequestHandler::WriteResponses(const RequestSource &next_request, json::ArrayWriter &writer, const Snapshot &catalogue)
+    {
+        parallel::ThreadPool &pool = GetPool();
+
+        // Каждый ответ сериализуется в свою строку. Выводятся они строго по порядку,
+        // но пока ожидается первый из них (например, долгий Map), следующие уже выполняются
+        const size_t window = thread_count_ * IN_FLIGHT_PER_THREAD;
+        const json::PrintOptions options = writer.GetOptions();
+        const int indent = writer.GetElementIndent();
+        std::deque<std::future<std::string>> in_flight;
+        auto write_front = [&writer, &in_flight]
+        {
+            const std::string response = in_flight.front().get();
+            in_flight.pop_front();
+            writer.BeginElement() << response;
+        };
+
+        try
+        {
+            while (const json::Node *next = next_request())
+            {
+                const json::Node &request = *next;
+                if (in_flight.size() == window)
+                {
+                    write_front();
+                }
+
+                // Запросы создаются в текущем потоке: создание Map обновляет настройки рендеринга
+                std::shared_ptr<const Request> single_request;
+                try
+                {
+                    single_request = CreateRequest(request);
+                }
+                catch (const std::exception &e)
+                {
+                    // Как и при последовательной обработке, вместо ответа выводится сообщение об ошибке
+                    std::ostringstream response;
+                    json::StreamBuilder builder(response, options, indent);
+                    WriteInvalidRequestResponse(builder, request, e.what());
+                    builder.Finish();
+                    std::promise<std::string> ready;
+                    ready.set_value(std::move(response).str());
+                    in_flight.push_back(ready.get_future());
+                    continue;
+                }
+
+                // Задача владеет всем, что использует: снимком каталога, запросом и настройками вывода
+                in_flight.push_back(pool.Submit([catalogue, single_request, options, indent]
+                                                  {
+                                                      std::ostringstream response;
+                                                      json::StreamBuilder builder(response, options, indent);
+                                                      single_request->ExecuteTo(*catalogue, builder);
+                                                      builder.Finish();
+                                                      return std::move(response).str(); }));
+            }
+
+            while (!in_flight.empty())
+            {
+                write_front();
+            }
+        }
+        catch (...)
+        {
+            // Ответы оставшихся задач отбрасываются, но сами задачи дорабатывают до выхода:
+            // исключение не должно опережать запросы, которые ещё выполняются в пуле
+            for (const std::future<std::string> &response : in_flight)
+            {
+                if (response.valid())
+                {
+                    response.wait();
+                }
+            }
+            throw;
+        }
     }
 
     void RequestHandler::ProcessStatRequests(const json::Node &stat_requests)
@@ -200,25 +729,67 @@ namespace request_handler
         }
 
         const json::Array &requests = stat_requests.AsArray();
-        json::Array responses;
 
         DEBUG_PRINT("Processing " << requests.size() << " stat requests...");
 
-        for (const json::Node &request : requests)
+        // Каждый ответ выводится сразу после выполнения запроса и не накапливается в памяти
+        // Все запросы документа выполняются на одном снимке каталога
+        json::ArrayWriter writer(output_);
+        try
         {
-            if (!request.IsDict())
-            {
-                throw json::ParsingError("Request must be a dictionary");
-            }
+            WriteResponses(requests, writer, AcquireCatalogue());
+        }
+        catch (...)
+        {
+            // Уже выведенные ответы остаются закрытым массивом, ошибка передаётся дальше
+            writer.Finish();
+            output_.flush();
+            throw;
+        }
+        writer.Finish();
+        output_.flush();
+    }
 
-            const json::Dict &request_dict = request.AsMap();
-            json::Node response = ProcessSingleRequest(request_dict);
-            responses.push_back(response);
+    void RequestHandler::ProcessStatRequests(const json::LazyNode &stat_requests)
+    {
+        if (!stat_requests.IsArray())
+        {
+            throw json::ParsingError("stat_requests must be an array");
         }
 
-        // Выводим результат в JSON формате
-        json::Document result_doc{json::Node(responses)};
-        json::Print(result_doc, std::cout);
+        json::ArrayWriter writer(output_);
+        const Snapshot catalogue = AcquireCatalogue();
+
+        try
+        {
+            if (thread_count_ < 2)
+            {
+                // Запрос разбирается непосредственно перед выполнением, поэтому первые ответы
+                // выводятся до того, как разобран весь массив
+                stat_requests.ForEachElement([this, &writer, &catalogue](const json::LazyNode &request)
+                                             { WriteResponse(request.Parse(), writer, *catalogue); });
+            }
+            else
+            {
+                // Запросы разбираются в пуле пакетами ограниченного размера: пока выполняется
+                // один пакет, разбирается следующий, а остальные ещё не материализованы.
+                // Окно выполняемых запросов общее для всех пакетов
+                const std::vector<json::LazyNode> requests = stat_requests.GetElements();
+                BatchParser parser(requests, GetPool());
+                WriteResponses([&parser]
+                               { return parser.Next(); },
+                               writer, catalogue);
+            }
+        }
+        catch (...)
+        {
+            // Например, синтаксическая ошибка в ещё не разобранной части массива
+            writer.Finish();
+            output_.flush();
+            throw;
+        }
+        writer.Finish();
+        output_.flush();
     }
 
 } // namespace request_handler
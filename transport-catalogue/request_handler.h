@@ -37,9 +37,13 @@ private:
 */
 
 #include "json.h"
+#include "json_builder.h"
+#include "json_lazy.h"
 #include "transport_catalogue.h"
 #include "map_renderer.h"
 #include "json_reader.h"
+#include "thread_pool.h"
+#include "versioned_catalogue.h"
 
 #ifdef DEBUG_PRINT
 #undef DEBUG_PRINT
@@ -51,7 +55,9 @@ private:
 
 #include <iostream>
 #include <memory>
+#include <optional>
 #include <string>
+#include <string_view>
 #include <vector>
 #include <functional>
 #include <unordered_map>
@@ -64,8 +70,10 @@ namespace request_handler
     {
     public:
         virtual ~Request() = default;
-        virtual json::Node Execute(const transport_catalogue::TransportCatalogue &catalogue) const = 0;
         virtual std::string GetType() const = 0;
+
+        // Записывает ответ сразу в поток, минуя построение json::Node
+        virtual void ExecuteTo(const transport_catalogue::TransportCatalogue &catalogue, json::StreamBuilder &builder) const = 0;
     };
 
     // Конкретные запросы
@@ -74,7 +82,7 @@ namespace request_handler
     public:
         StopRequest(const std::string &name, int id) : name_(name), id_(id) {}
 
-        json::Node Execute(const transport_catalogue::TransportCatalogue &catalogue) const override;
+        void ExecuteTo(const transport_catalogue::TransportCatalogue &catalogue, json::StreamBuilder &builder) const override;
         std::string GetType() const override { return "Stop"; }
 
     private:
@@ -87,7 +95,7 @@ namespace request_handler
     public:
         BusRequest(const std::string &name, int id) : name_(name), id_(id) {}
 
-        json::Node Execute(const transport_catalogue::TransportCatalogue &catalogue) const override;
+        void ExecuteTo(const transport_catalogue::TransportCatalogue &catalogue, json::StreamBuilder &builder) const override;
         std::string GetType() const override { return "Bus"; }
 
     private:
@@ -98,14 +106,37 @@ namespace request_handler
     class MapRequest : public Request
     {
     public:
-        MapRequest(int id, const map_renderer::Render &renderer) : id_(id), renderer_(renderer) {}
+        // Без viewport отрисовывается вся карта
+        MapRequest(int id, const map_renderer::Render &renderer,
+                   std::optional<map_renderer::Viewport> viewport = std::nullopt)
+            : id_(id), renderer_(renderer), viewport_(std::move(viewport)) {}
 
-        json::Node Execute(const transport_catalogue::TransportCatalogue &catalogue) const override;
+        void ExecuteTo(const transport_catalogue::TransportCatalogue &catalogue, json::StreamBuilder &builder) const override;
         std::string GetType() const override { return "Map"; }
 
     private:
+        // Отрисовывает часть карты, заданную viewport_
+        std::string RenderViewport(const transport_catalogue::TransportCatalogue &catalogue) const;
+
         int id_;
         map_renderer::Render renderer_;
+        std::optional<map_renderer::Viewport> viewport_;
+    };
+
+    // Плитка карты z/x/y в проекции Web Mercator
+    class TileRequest : public Request
+    {
+    public:
+        TileRequest(int id, const map_renderer::Render &renderer, const map_renderer::TileId &tile)
+            : id_(id), renderer_(renderer), tile_(tile) {}
+
+        void ExecuteTo(const transport_catalogue::TransportCatalogue &catalogue, json::StreamBuilder &builder) const override;
+        std::string GetType() const override { return "Tile"; }
+
+    private:
+        int id_;
+        map_renderer::Render renderer_;
+        map_renderer::TileId tile_;
     };
 
     // Реестр запросов
@@ -128,12 +159,14 @@ namespace request_handler
         static std::unique_ptr<Request> CreateStopRequest(const json::Dict &request_dict, const map_renderer::Render &renderer);
         static std::unique_ptr<Request> CreateBusRequest(const json::Dict &request_dict, const map_renderer::Render &renderer);
         static std::unique_ptr<Request> CreateMapRequest(const json::Dict &request_dict, const map_renderer::Render &renderer);
+        static std::unique_ptr<Request> CreateTileRequest(const json::Dict &request_dict, const map_renderer::Render &renderer);
     };
 
     class RequestHandler
     {
     public:
-        explicit RequestHandler(transport_catalogue::TransportCatalogue &catalogue);
+        // Ответы на stat_requests выводятся в output по мере выполнения запросов
+        explicit RequestHandler(transport_catalogue::TransportCatalogue &catalogue, std::ostream &output = std::cout);
 
         // Обработка JSON документа (основной метод)
         void ProcessDocument(const json::Document &document);
@@ -141,21 +174,88 @@ namespace request_handler
         // Обработка запросов из JSON документа
         json::Document ProcessRequests(const json::Document &document);
 
+        // То же для документа, разбираемого по требованию: каждый запрос разбирается
+        // и выполняется по отдельности, настройки рендеринга разбираются при первом запросе Map
+        void ProcessDocument(const json::LazyDocument &document);
+        void ProcessRequests(const json::LazyDocument &document);
+
+        // Обработка одной строки потока запросов (JSON Lines). Строка содержит один запрос,
+        // массив запросов или словарь со stat_requests. Ответ выводится одной строкой:
+        // словарь для одиночного запроса, массив для пакета. При ошибке выводится
+        // словарь с полем error_message (и request_id, если он есть в запросе),
+        // обработка следующих строк продолжается
+        void ProcessRequestLine(std::string_view line);
+
+        // То же, но ответ (без перевода строки) возвращается, а не выводится.
+        // Допускает одновременные вызовы из нескольких потоков, если запросы выполняются
+        // в вызывающем потоке (SetThreadCount(1)) и настройки рендеринга уже разобраны (GetRenderSettings)
+        std::string AnswerRequestLine(std::string_view line);
+
+        // Число потоков для выполнения stat_requests (по умолчанию - число ядер).
+        // Запросы выполняются параллельно, ответы выводятся в порядке запросов.
+        // При значении 1 запросы выполняются последовательно в вызывающем потоке
+        void SetThreadCount(size_t thread_count);
+
+        // Переключает обработчик на версионированный каталог: каждый пакет запросов выполняется
+        // на снимке текущей версии, а строка с base_requests в ProcessRequestLine публикует
+        // новую версию, не прерывая чтение. Каталог, переданный в конструктор, больше не используется
+        void UseVersions(transport_catalogue::VersionedCatalogue &versions);
+
+        // Настройки рендеринга с учётом отложенных (из render_settings загруженного документа)
+        const map_renderer::RenderSettings &GetRenderSettings();
+
+        // Задаёт настройки рендеринга напрямую, например загруженные из снимка каталога
+        void SetRenderSettings(const map_renderer::RenderSettings &settings);
+
     private:
+        using Snapshot = transport_catalogue::VersionedCatalogue::Snapshot;
+
+        // Каталог, на котором выполняется очередной пакет запросов
+        Snapshot AcquireCatalogue() const;
+
+        // Применяет base_requests к новой версии каталога и возвращает её номер
+        uint64_t ApplyUpdate(const json::Node &base_requests);
+
         // Регистрация типов запросов
         void RegisterRequestTypes();
 
-        // Обработка одного запроса
-        json::Node ProcessSingleRequest(const json::Dict &request_dict);
+        // Создание запроса по его описанию
+        std::unique_ptr<Request> CreateRequest(const json::Node &request);
+        std::unique_ptr<Request> CreateRequest(const json::Dict &request_dict);
+
+        // Применяет отложенные настройки рендеринга перед первым запросом Map
+        void PrepareRenderer();
+
+        // Выполняет запрос и записывает ответ очередным элементом массива. Вместо ответа
+        // на некорректный запрос записывается словарь с error_message и request_id, если он есть
+        void WriteResponse(const json::Node &request, json::ArrayWriter &writer,
+                           const transport_catalogue::TransportCatalogue &catalogue);
+
+        // Выполняет пакет запросов в пуле потоков и записывает ответы в исходном порядке
+        void WriteResponses(const json::Array &requests, json::ArrayWriter &writer, const Snapshot &catalogue);
+
+        // То же для запросов, которые выдаёт next_request (nullptr - запросы закончились).
+        // Запрос должен оставаться действительным только до следующего вызова next_request
+        using RequestSource = std::function<const json::Node *()>;
+        void WriteResponses(const RequestSource &next_request, json::ArrayWriter &writer, const Snapshot &catalogue);
+
+        // Пул потоков для stat_requests, создаётся при первом обращении
+        parallel::ThreadPool &GetPool();
 
         // Обработка статистических запросов
         void ProcessStatRequests(const json::Node &stat_requests);
+        void ProcessStatRequests(const json::LazyNode &stat_requests);
 
     private:
         transport_catalogue::TransportCatalogue &catalogue_;
+        std::ostream &output_;
         json_reader::JsonReader json_reader_;
         map_renderer::Render renderer_;
         RequestRegistry request_registry_;
+        size_t thread_count_;
+        // Создаётся при первом параллельном пакете
+        std::unique_ptr<parallel::ThreadPool> pool_;
+        transport_catalogue::VersionedCatalogue *versions_ = nullptr;
     };
 
 } // namespace request_handler
@@ -0,0 +1,723 @@
+#include "serialization.h"
+
+#ifdef DEBUG_PRINT
+#undef DEBUG_PRINT
+#endif
+#define DEBUG_PRINT(x) \
+    do                 \
+    {                  \
+    } while (0)
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+namespace serialization
+{
+
+    namespace
+    {
+        using namespace std::literals;
+
+        constexpr char MAGIC[8] = {'T', 'C', 'B', 'A', 'S', 'E', '\0', '\0'};
+
+        static_assert(sizeof(FileHeader) == 16);
+        static_assert(sizeof(SectionHeader) == 16);
+        static_assert(sizeof(StopRecord) == 24);
+        static_assert(sizeof(RouteRecord) == 24);
+        static_assert(sizeof(DistanceRecord) == 16);
+
+        // Метки вариантов цвета в секции настроек рендеринга
+        enum class ColorTag : uint8_t
+        {
+            NAME = 0,
+            RGB = 1,
+            RGBA = 2,
+        };
+
+        size_t Padding(size_t size)
+        {
+            return (SECTION_ALIGNMENT - size % SECTION_ALIGNMENT) % SECTION_ALIGNMENT;
+        }
+
+        uint32_t CheckedSize(size_t size)
+        {
+            if (size > std::numeric_limits<uint32_t>::max())
+            {
+                throw FormatError("Catalogue is too large for the snapshot format"s);
+            }
+            return static_cast<uint32_t>(size);
+        }
+
+        template <typename T>
+        void AppendPod(std::string &buffer, const T &value)
+        {
+            buffer.append(reinterpret_cast<const char *>(&value), sizeof(T));
+        }
+
+        void WriteSection(std::ostream &output, SectionId id, const void *data, size_t size)
+        {
+            serialization::WriteSection(output, static_cast<uint32_t>(id), std::string_view(static_cast<const char *>(data), size));
+        }
+
+        template <typename T>
+        void WriteSection(std::ostream &output, SectionId id, const std::vector<T> &records)
+        {
+            WriteSection(output, id, records.data(), records.size() * sizeof(T));
+        }
+
+        // Производная секция: DerivedHeader, затем данные индекса
+        template <typename T>
+        void WriteDerivedSection(std::ostream &output, SectionId id, uint32_t version, const std::vector<T> &records)
+        {
+            const std::string_view data(reinterpret_cast<const char *>(records.data()), records.size() * sizeof(T));
+            const DerivedHeader derived{version, 0, Checksum(data)};
+            const SectionHeader header{static_cast<uint32_t>(id), 0, sizeof(derived) + data.size()};
+            output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+            output.write(reinterpret_cast<const char *>(&derived), sizeof(derived));
+            output.write(data.data(), static_cast<std::streamsize>(data.size()));
+            static constexpr char zeros[SECTION_ALIGNMENT] = {};
+            output.write(zeros, static_cast<std::streamsize>(Padding(header.size)));
+        }
+
+        // Записи производной секции, если совпадают версия и контрольная сумма
+        template <typename T>
+        std::optional<Records<T>> DerivedRecords(std::string_view section, uint32_t version)
+        {
+            DerivedHeader header{};
+            if (section.size() < sizeof(header))
+            {
+                return std::nullopt;
+            }
+            std::memcpy(&header, section.data(), sizeof(header));
+            const std::string_view data = section.substr(sizeof(header));
+            if (header.version != version || data.size() % sizeof(T) != 0 ||
+                reinterpret_cast<uintptr_t>(data.data()) % alignof(T) != 0 || Checksum(data) != header.checksum)
+            {
+                DEBUG_PRINT("Derived section rejected");
+                return std::nullopt;
+            }
+            return Records<T>{reinterpret_cast<const T *>(data.data()), data.size() / sizeof(T)};
+        }
+
+        // Читает секцию в буфер, выровненный для записей любого типа
+        std::string_view ReadAligned(std::istream &input, uint64_t size, std::vector<uint64_t> &storage)
+        {
+            storage.assign((size + sizeof(uint64_t) - 1) / sizeof(uint64_t), 0);
+            input.read(reinterpret_cast<char *>(storage.data()), static_cast<std::streamsize>(size));
+            return std::string_view(reinterpret_cast<const char *>(storage.data()), size);
+        }
+
+        // Последовательное чтение значений из буфера с проверкой границ
+        class ByteReader
+        {
+        public:
+            explicit ByteReader(std::string_view data)
+                : data_(data)
+            {
+            }
+
+            template <typename T>
+            T Read()
+            {
+                T value;
+                std::memcpy(&value, Take(sizeof(T)).data(), sizeof(T));
+                return value;
+            }
+
+            std::string_view Take(size_t size)
+            {
+                if (size > data_.size())
+                {
+                    throw FormatError("Truncated render settings section"s);
+                }
+                std::string_view result = data_.substr(0, size);
+                data_.remove_prefix(size);
+                return result;
+            }
+
+            size_t GetRemaining() const
+            {
+                return data_.size();
+            }
+
+        private:
+            std::string_view data_;
+        };
+
+        void AppendColor(std::string &buffer, const map_renderer::Color &color)
+        {
+            if (const auto *name = std::get_if<std::string>(&color.value))
+            {
+                AppendPod(buffer, ColorTag::NAME);
+                AppendPod(buffer, CheckedSize(name->size()));
+                buffer += *name;
+            }
+            else if (const auto *rgb = std::get_if<std::vector<int>>(&color.value))
+            {
+                AppendPod(buffer, ColorTag::RGB);
+                for (size_t i = 0; i < 3; ++i)
+                {
+                    AppendPod(buffer, static_cast<int32_t>(rgb->at(i)));
+                }
+            }
+            else
+            {
+                const auto &rgba = std::get<std::vector<double>>(color.value);
+                AppendPod(buffer, ColorTag::RGBA);
+                for (size_t i = 0; i < 3; ++i)
+                {
+                    AppendPod(buffer, static_cast<int32_t>(rgba.at(i)));
+                }
+                AppendPod(buffer, rgba.at(3));
+            }
+        }
+
+        map_renderer::Color ReadColor(ByteReader &reader)
+        {
+            switch (reader.Read<ColorTag>())
+            {
+            case ColorTag::NAME:
+            {
+                const uint32_t size = reader.Read<uint32_t>();
+                return map_renderer::Color(std::string(reader.Take(size)));
+            }
+            case ColorTag::RGB:
+            {
+                const int32_t r = reader.Read<int32_t>();
+                const int32_t g = reader.Read<int32_t>();
+                const int32_t b = reader.Read<int32_t>();
+                return map_renderer::Color(r, g, b);
+            }
+            case ColorTag::RGBA:
+            {
+                const int32_t r = reader.Read<int32_t>();
+                const int32_t g = reader.Read<int32_t>();
+                const int32_t b = reader.Read<int32_t>();
+                return map_renderer::Color(r, g, b, reader.Read<double>());
+            }
+            }
+            throw FormatError("Unknown color tag"s);
+        }
+
+        std::string EncodeRenderSettings(const map_renderer::RenderSettings &settings)
+        {
+            std::string buffer;
+            AppendPod(buffer, settings.width);
+            AppendPod(buffer, settings.height);
+            AppendPod(buffer, settings.padding);
+            AppendPod(buffer, settings.line_width);
+            AppendPod(buffer, settings.stop_radius);
+            AppendPod(buffer, static_cast<int32_t>(settings.bus_label_font_size));
+            AppendPod(buffer, settings.bus_label_offset.dx);
+            AppendPod(buffer, settings.bus_label_offset.dy);
+            AppendPod(buffer, static_cast<int32_t>(settings.stop_label_font_size));
+            AppendPod(buffer, settings.stop_label_offset.dx);
+            AppendPod(buffer, settings.stop_label_offset.dy);
+            AppendColor(buffer, settings.underlayer_color);
+            AppendPod(buffer, settings.underlayer_width);
+            AppendPod(buffer, CheckedSize(settings.color_palette.size()));
+            for (const map_renderer::Color &color : settings.color_palette)
+            {
+                AppendColor(buffer, color);
+            }
+            return buffer;
+        }
+
+        // Читает данные секции целиком в массив записей
+        template <typename T>
+        std::vector<T> ReadRecords(std::istream &input, uint64_t size)
+        {
+            if (size % sizeof(T) != 0)
+            {
+                throw FormatError("Section size is not a multiple of its record size"s);
+            }
+            std::vector<T> records(size / sizeof(T));
+            input.read(reinterpret_cast<char *>(records.data()), static_cast<std::streamsize>(size));
+            return records;
+        }
+
+    } // namespace
+
+    void WriteFileHeader(std::ostream &output, const char (&magic)[8], uint32_t format_version)
+    {
+        FileHeader header{};
+        std::memcpy(header.magic, magic, sizeof(header.magic));
+        header.byte_order = BYTE_ORDER_MARK;
+        header.format_version = format_version;
+        output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+    }
+
+    void CheckFileHeader(const FileHeader &header, const char (&magic)[8], uint32_t format_version)
+    {
+        if (std::memcmp(header.magic, magic, sizeof(header.magic)) != 0)
+        {
+            throw FormatError("Unexpected file signature"s);
+        }
+        if (header.byte_order != BYTE_ORDER_MARK)
+        {
+            throw FormatError("File was written with a different byte order"s);
+        }
+        if (header.format_version != format_version)
+        {
+            throw FormatError("Unsupported format version: "s + std::to_string(header.format_version));
+        }
+    }
+
+    void CheckFileHeader(const FileHeader &header)
+    {
+        if (std::memcmp(header.magic, MAGIC, sizeof(MAGIC)) != 0)
+        {
+            throw FormatError("Not a catalogue snapshot"s);
+        }
+        CheckFileHeader(header, MAGIC, FORMAT_VERSION);
+    }
+
+    void WriteSection(std::ostream &output, uint32_t id, std::string_view data)
+    {
+        const SectionHeader header{id, 0, data.size()};
+        output.write(reinterpret_cast<const char *>(&header), sizeof(header));
+        output.write(data.data(), static_cast<std::streamsize>(data.size()));
+        static constexpr char zeros[SECTION_ALIGNMENT] = {};
+        output.write(zeros, static_cast<std::streamsize>(Padding(data.size())));
+    }
+
+    void CheckSectionSize(std::istream &input, uint64_t size)
+    {
+        const std::streampos position = input.tellg();
+        if (position == std::streampos(-1))
+        {
+            return;
+        }
+        input.seekg(0, std::ios::end);
+        const std::streampos end = input.tellg();
+        input.seekg(position);
+        if (!input || end == std::streampos(-1))
+        {
+            throw FormatError("Cannot determine snapshot length"s);
+        }
+        if (size > static_cast<uint64_t>(end - position))
+        {
+            throw FormatError("Section size exceeds the remaining file length"s);
+        }
+    }
+
+    std::string_view PoolString(std::string_view pool, uint32_t offset, uint32_t size)
+    {
+        if (offset > pool.size() || size > pool.size() - offset)
+        {
+            throw FormatError("Name is out of the string pool"s);
+        }
+        return pool.substr(offset, size);
+    }
+
+    uint64_t Checksum(std::string_view data)
+    {
+        uint64_t hash = 14695981039346656037ull;
+        for (const char c : data)
+        {
+            hash ^= static_cast<unsigned char>(c);
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    std::optional<StopRouteIndex> ReadStopRouteIndex(const SnapshotView &snapshot)
+    {
+        const auto offsets = DerivedRecords<uint32_t>(snapshot.stop_route_offsets, STOP_ROUTES_VERSION);
+        const auto routes = DerivedRecords<uint32_t>(snapshot.stop_routes, STOP_ROUTES_VERSION);
+        if (!offsets || !routes || offsets->size != snapshot.stops.size + 1 || (*offsets)[0] != 0 ||
+            (*offsets)[snapshot.stops.size] != routes->size)
+        {
+            return std::nullopt;
+        }
+        for (size_t stop = 0; stop < snapshot.stops.size; ++stop)
+        {
+            if ((*offsets)[stop] > (*offsets)[stop + 1])
+            {
+                return std::nullopt;
+            }
+        }
+        for (const uint32_t route : *routes)
+        {
+            if (route >= snapshot.routes.size)
+            {
+                return std::nullopt;
+            }
+        }
+        return StopRouteIndex{*offsets, *routes};
+    }
+
+    std::optional<Records<RouteInfoRecord>> ReadRouteInfos(const SnapshotView &snapshot)
+    {
+        auto infos = DerivedRecords<RouteInfoRecord>(snapshot.route_infos, ROUTE_INFOS_VERSION);
+        if (!infos || infos->size != snapshot.routes.size)
+        {
+            return std::nullopt;
+        }
+        return infos;
+    }
+
+    void ComputeStopRouteIndex(size_t stop_count, Records<RouteRecord> routes, Records<uint32_t> route_stops,
+                               std::vector<uint32_t> &offsets, std::vector<uint32_t> &stop_routes)
+    {
+        // Маршруты упорядочены по имени, поэтому после сортировки пар
+        // списки маршрутов каждой остановки тоже упорядочены по имени
+        std::vector<std::pair<uint32_t, uint32_t>> pairs;
+        pairs.reserve(route_stops.size);
+        for (uint32_t route = 0; route < routes.size; ++route)
+        {
+            const RouteRecord &record = routes[route];
+            if (record.first_stop > route_stops.size || record.stop_count > route_stops.size - record.first_stop)
+            {
+                throw FormatError("Route stops are out of range"s);
+            }
+            for (uint32_t i = 0; i < record.stop_count; ++i)
+            {
+                const uint32_t stop = route_stops[record.first_stop + i];
+                if (stop >= stop_count)
+                {
+                    throw FormatError("Stop index is out of range"s);
+                }
+                pairs.emplace_back(stop, route);
+            }
+        }
+        std::sort(pairs.begin(), pairs.end());
+        pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
+        offsets.assign(stop_count + 1, 0);
+        stop_routes.clear();
+        stop_routes.reserve(pairs.size());
+        for (const auto &[stop, route] : pairs)
+        {
+            ++offsets[stop + 1];
+            stop_routes.push_back(route);
+        }
+        for (size_t stop = 0; stop < stop_count; ++stop)
+        {
+            offsets[stop + 1] += offsets[stop];
+        }
+    }
+
+    map_renderer::RenderSettings DecodeRenderSettings(std::string_view data)
+    {
+        ByteReader reader(data);
+        map_renderer::RenderSettings settings;
+        settings.width = reader.Read<double>();
+        settings.height = reader.Read<double>();
+        settings.padding = reader.Read<double>();
+        settings.line_width = reader.Read<double>();
+        settings.stop_radius = reader.Read<double>();
+        settings.bus_label_font_size = reader.Read<int32_t>();
+        settings.bus_label_offset.dx = reader.Read<double>();
+        settings.bus_label_offset.dy = reader.Read<double>();
+        settings.stop_label_font_size = reader.Read<int32_t>();
+        settings.stop_label_offset.dx = reader.Read<double>();
+        settings.stop_label_offset.dy = reader.Read<double>();
+        settings.underlayer_color = ReadColor(reader);
+        settings.underlayer_width = reader.Read<double>();
+        const uint32_t palette_size = reader.Read<uint32_t>();
+        // Каждый цвет занимает хотя бы байт тега
+        if (palette_size > reader.GetRemaining())
+        {
+            throw FormatError("Truncated render settings section"s);
+        }
+        settings.color_palette.reserve(palette_size);
+        for (uint32_t i = 0; i < palette_size; ++i)
+        {
+            settings.color_palette.push_back(ReadColor(reader));
+        }
+        return settings;
+    }
+
+    void BuildCatalogue(const SnapshotView &snapshot, transport_catalogue::TransportCatalogue &catalogue)
+    {
+        // Остановки: имена копируются из пула ровно один раз
+        catalogue.Reserve(snapshot.stops.size, snapshot.routes.size, snapshot.distances.size);
+        std::vector<transport_catalogue::StopInput> stop_inputs;
+        stop_inputs.reserve(snapshot.stops.size);
+        for (const StopRecord &record : snapshot.stops)
+        {
+            stop_inputs.push_back({PoolString(snapshot.strings, record.name_offset, record.name_size),
+                                   {record.lat, record.lng}});
+        }
+        catalogue.AddStops(stop_inputs);
+
+        std::vector<const Stop *> stops;
+        stops.reserve(stop_inputs.size());
+        for (const transport_catalogue::StopInput &input_stop : stop_inputs)
+        {
+            stops.push_back(catalogue.GetStopContainer().GetStop(input_stop.name));
+        }
+        auto stop_at = [&stops](uint32_t index)
+        {
+            if (index >= stops.size())
+            {
+                throw FormatError("Stop index is out of range"s);
+            }
+            return stops[index];
+        };
+
+        // Маршруты хранятся уже развёрнутыми, поэтому имена остановок не разрешаются повторно
+        std::vector<std::unique_ptr<Route>> routes;
+        routes.reserve(snapshot.routes.size);
+        for (const RouteRecord &record : snapshot.routes)
+        {
+            if (record.first_stop > snapshot.route_stops.size ||
+                record.stop_count > snapshot.route_stops.size - record.first_stop)
+            {
+                throw FormatError("Route stops are out of range"s);
+            }
+            auto route = std::make_unique<Route>();
+            route->name = std::string(PoolString(snapshot.strings, record.name_offset, record.name_size));
+            route->is_roundtrip = record.is_roundtrip != 0;
+            route->stops.reserve(record.stop_count);
+            for (uint32_t i = 0; i < record.stop_count; ++i)
+            {
+                route->stops.push_back(stop_at(snapshot.route_stops[record.first_stop + i]));
+            }
+            routes.push_back(std::move(route));
+        }
+        std::vector<const Route *> route_ptrs;
+        route_ptrs.reserve(routes.size());
+        for (const auto &route : routes)
+        {
+            route_ptrs.push_back(route.get());
+        }
+        catalogue.AddPreparedRoutes(std::move(routes));
+
+        for (const DistanceRecord &record : snapshot.distances)
+        {
+            catalogue.AddDistance(stop_at(record.from), stop_at(record.to), record.distance);
+        }
+
+        // Индексы принимаются, только если оба пригодны и все остановки и маршруты снимка
+        // остались в каталоге (повторяющиеся имена заменили бы друг друга)
+        const auto stop_route_index = ReadStopRouteIndex(snapshot);
+        const auto route_infos = ReadRouteInfos(snapshot);
+        if (!stop_route_index || !route_infos || catalogue.GetStopContainer().Size() != stops.size() ||
+            catalogue.GetRouteContainer().Size() != route_ptrs.size())
+        {
+            DEBUG_PRINT("Snapshot indexes are missing or stale, they will be rebuilt");
+            return;
+        }
+
+        std::unordered_map<const Stop *, std::vector<std::string_view>> stop_routes;
+        stop_routes.reserve(stops.size());
+        for (uint32_t stop = 0; stop < stops.size(); ++stop)
+        {
+            const uint32_t begin = stop_route_index->offsets[stop];
+            const uint32_t end = stop_route_index->offsets[stop + 1];
+            if (begin == end)
+            {
+                continue;
+            }
+            std::vector<std::string_view> &names = stop_routes[stops[stop]];
+            names.reserve(end - begin);
+            for (uint32_t i = begin; i < end; ++i)
+            {
+                names.push_back(route_ptrs[stop_route_index->routes[i]]->name);
+            }
+        }
+
+        std::unordered_map<const Route *, transport_catalogue::RouteInfo> infos;
+        infos.reserve(route_ptrs.size());
+        for (size_t route = 0; route < route_ptrs.size(); ++route)
+        {
+            const RouteInfoRecord &record = (*route_infos)[route];
+            infos.emplace(route_ptrs[route], transport_catalogue::RouteInfo{record.stops_count, record.unique_stops_count,
+                                                                            record.route_length, record.curvature});
+        }
+        catalogue.AdoptIndexes(std::move(stop_routes), std::move(infos));
+    }
+
+    void SaveCatalogue(std::ostream &output, const transport_catalogue::TransportCatalogue &catalogue,
+                       const map_renderer::RenderSettings &render_settings)
+    {
+        // Остановки и маршруты упорядочены по имени, чтобы одинаковые каталоги давали одинаковые файлы
+        auto by_name = [](const auto *lhs, const auto *rhs)
+        {
+            return lhs->name < rhs->name;
+        };
+        std::vector<const Stop *> stops = catalogue.GetStopContainer().GetAllStops();
+        std::vector<const Route *> routes = catalogue.GetRouteContainer().GetAllRoutes();
+        std::sort(stops.begin(), stops.end(), by_name);
+        std::sort(routes.begin(), routes.end(), by_name);
+
+        std::string pool;
+        std::unordered_map<const Stop *, uint32_t> stop_indices;
+        stop_indices.reserve(stops.size());
+
+        std::vector<StopRecord> stop_records;
+        stop_records.reserve(stops.size());
+        for (const Stop *stop : stops)
+        {
+            stop_indices.emplace(stop, CheckedSize(stop_records.size()));
+            stop_records.push_back({CheckedSize(pool.size()), CheckedSize(stop->name.size()),
+                                    stop->coordinates.lat, stop->coordinates.lng});
+            pool += stop->name;
+        }
+
+        std::vector<RouteRecord> route_records;
+        std::vector<uint32_t> route_stops;
+        route_records.reserve(routes.size());
+        for (const Route *route : routes)
+        {
+            route_records.push_back({CheckedSize(pool.size()), CheckedSize(route->name.size()),
+                                     CheckedSize(route_stops.size()), CheckedSize(route->stops.size()),
+                                     route->is_roundtrip ? 1u : 0u, 0});
+            pool += route->name;
+            for (const Stop *stop : route->stops)
+            {
+                route_stops.push_back(stop_indices.at(stop));
+            }
+        }
+
+        std::vector<DistanceRecord> distance_records;
+        catalogue.ForEachDistance([&distance_records, &stop_indices](const Stop *from, const Stop *to, double distance)
+                                  { distance_records.push_back({stop_indices.at(from), stop_indices.at(to), distance}); });
+        std::sort(distance_records.begin(), distance_records.end(), [](const DistanceRecord &lhs, const DistanceRecord &rhs)
+                  { return std::tie(lhs.from, lhs.to) < std::tie(rhs.from, rhs.to); });
+
+        // Производные индексы: маршруты через остановку и статистика маршрутов
+        std::vector<uint32_t> stop_route_offsets;
+        std::vector<uint32_t> stop_routes;
+        ComputeStopRouteIndex(stop_records.size(), {route_records.data(), route_records.size()},
+                              {route_stops.data(), route_stops.size()}, stop_route_offsets, stop_routes);
+
+        std::vector<RouteInfoRecord> route_infos;
+        route_infos.reserve(routes.size());
+        for (const Route *route : routes)
+        {
+            const transport_catalogue::RouteInfo info = catalogue.GetRouteInfo(route->name);
+            route_infos.push_back({info.stops_count, info.unique_stops_count, info.route_length, info.curvature});
+        }
+
+        WriteFileHeader(output, MAGIC, FORMAT_VERSION);
+        WriteSection(output, SectionId::STRINGS, pool.data(), pool.size());
+        WriteSection(output, SectionId::STOPS, stop_records);
+        WriteSection(output, SectionId::ROUTES, route_records);
+        WriteSection(output, SectionId::ROUTE_STOPS, route_stops);
+        WriteSection(output, SectionId::DISTANCES, distance_records);
+        WriteDerivedSection(output, SectionId::STOP_ROUTE_OFFSETS, STOP_ROUTES_VERSION, stop_route_offsets);
+        WriteDerivedSection(output, SectionId::STOP_ROUTES, STOP_ROUTES_VERSION, stop_routes);
+        WriteDerivedSection(output, SectionId::ROUTE_INFOS, ROUTE_INFOS_VERSION, route_infos);
+        const std::string settings = EncodeRenderSettings(render_settings);
+        WriteSection(output, SectionId::RENDER_SETTINGS, settings.data(), settings.size());
+
+        if (!output)
+        {
+            throw std::runtime_error("Failed to write catalogue snapshot"s);
+        }
+        DEBUG_PRINT("Saved " << stop_records.size() << " stops, " << route_records.size() << " routes, "
+                             << distance_records.size() << " distances");
+    }
+
+    void SaveCatalogue(const std::string &path, const transport_catalogue::TransportCatalogue &catalogue,
+                       const map_renderer::RenderSettings &render_settings)
+    {
+        std::ofstream output(path, std::ios::binary | std::ios::trunc);
+        if (!output)
+        {
+            throw std::runtime_error("Cannot open file for writing: "s + path);
+        }
+        SaveCatalogue(output, catalogue, render_settings);
+    }
+
+    map_renderer::RenderSettings LoadCatalogue(std::istream &input, transport_catalogue::TransportCatalogue &catalogue)
+    {
+        FileHeader header{};
+        if (!input.read(reinterpret_cast<char *>(&header), sizeof(header)))
+        {
+            throw FormatError("Not a catalogue snapshot"s);
+        }
+        CheckFileHeader(header);
+
+        std::string pool;
+        std::vector<StopRecord> stop_records;
+        std::vector<RouteRecord> route_records;
+        std::vector<uint32_t> route_stops;
+        std::vector<DistanceRecord> distance_records;
+        map_renderer::RenderSettings render_settings;
+        SnapshotView snapshot;
+        std::vector<uint64_t> stop_route_offsets;
+        std::vector<uint64_t> stop_routes;
+        std::vector<uint64_t> route_infos;
+
+        SectionHeader section{};
+        while (input.read(reinterpret_cast<char *>(&section), sizeof(section)))
+        {
+            CheckSectionSize(input, section.size);
+            switch (static_cast<SectionId>(section.id))
+            {
+            case SectionId::STRINGS:
+                pool = std::string(section.size, '\0');
+                input.read(pool.data(), static_cast<std::streamsize>(section.size));
+                break;
+            case SectionId::STOPS:
+                stop_records = ReadRecords<StopRecord>(input, section.size);
+                break;
+            case SectionId::ROUTES:
+                route_records = ReadRecords<RouteRecord>(input, section.size);
+                break;
+            case SectionId::ROUTE_STOPS:
+                route_stops = ReadRecords<uint32_t>(input, section.size);
+                break;
+            case SectionId::DISTANCES:
+                distance_records = ReadRecords<DistanceRecord>(input, section.size);
+                break;
+            case SectionId::RENDER_SETTINGS:
+            {
+                std::string settings(section.size, '\0');
+                input.read(settings.data(), static_cast<std::streamsize>(section.size));
+                render_settings = DecodeRenderSettings(settings);
+                break;
+            }
+            case SectionId::STOP_ROUTE_OFFSETS:
+                snapshot.stop_route_offsets = ReadAligned(input, section.size, stop_route_offsets);
+                break;
+            case SectionId::STOP_ROUTES:
+                snapshot.stop_routes = ReadAligned(input, section.size, stop_routes);
+                break;
+            case SectionId::ROUTE_INFOS:
+                snapshot.route_infos = ReadAligned(input, section.size, route_infos);
+                break;
+            default:
+                DEBUG_PRINT("Skipping unknown section " << section.id);
+                input.ignore(static_cast<std::streamsize>(section.size));
+                break;
+            }
+            input.ignore(static_cast<std::streamsize>(Padding(section.size)));
+            if (!input)
+            {
+                throw FormatError("Truncated snapshot section"s);
+            }
+        }
+
+        snapshot.strings = pool;
+        snapshot.stops = {stop_records.data(), stop_records.size()};
+        snapshot.routes = {route_records.data(), route_records.size()};
+        snapshot.route_stops = {route_stops.data(), route_stops.size()};
+        snapshot.distances = {distance_records.data(), distance_records.size()};
+        BuildCatalogue(snapshot, catalogue);
+
+        DEBUG_PRINT("Loaded " << stop_records.size() << " stops, " << route_records.size() << " routes, "
+                              << distance_records.size() << " distances");
+        return render_settings;
+    }
+
+    map_renderer::RenderSettings LoadCatalogue(const std::string &path, transport_catalogue::TransportCatalogue &catalogue)
+    {
+        std::ifstream input(path, std::ios::binary);
+        if (!input)
+        {
+            throw std::runtime_error("Cannot open file for reading: "s + path);
+        }
+        return LoadCatalogue(input, catalogue);
+    }
+
+} // namespace serialization
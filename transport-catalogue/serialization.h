@@ -0,0 +1,204 @@
+#pragma once
+
+/*
+ * Двоичный снимок каталога: остановки, маршруты, расстояния и настройки рендеринга.
+ *
+ * Формат: заголовок файла, затем секции { id, размер } с данными, выровненными на 8 байт.
+ * Записи остановок, маршрутов и расстояний имеют фиксированный размер и читаются массивами
+ * за одну операцию; имена хранятся в общем пуле строк и адресуются смещениями.
+ * Числа записываются в порядке байтов машины, порядок проверяется при загрузке.
+ * Файлы другой версии формата не загружаются, неизвестные секции пропускаются.
+ *
+ * Производные индексы (маршруты через остановку, статистика маршрутов) необязательны:
+ * у каждого своя версия и контрольная сумма. Пригодный индекс принимается загрузчиком
+ * вместо построения, устаревший или повреждённый - пересчитывается.
+ */
+
+#include "map_renderer.h"
+#include "transport_catalogue.h"
+
+#include <cstdint>
+#include <istream>
+#include <optional>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace serialization
+{
+
+    // Версия формата. Увеличивается при любом несовместимом изменении записей
+    constexpr uint32_t FORMAT_VERSION = 1;
+
+    // Данные каждой секции дополняются нулями до кратного размера
+    constexpr size_t SECTION_ALIGNMENT = 8;
+
+    class FormatError : public std::runtime_error
+    {
+    public:
+        using runtime_error::runtime_error;
+    };
+
+    // Идентификаторы секций
+    enum class SectionId : uint32_t
+    {
+        STRINGS = 1,
+        STOPS = 2,
+        ROUTES = 3,
+        ROUTE_STOPS = 4,
+        DISTANCES = 5,
+        RENDER_SETTINGS = 6,
+        // Производные индексы (см. DerivedHeader).
+        // Маршруты через остановку: границы списков (число остановок + 1) и сами списки
+        STOP_ROUTE_OFFSETS = 7,
+        STOP_ROUTES = 8,
+        // Статистика маршрутов в порядке секции ROUTES
+        ROUTE_INFOS = 9,
+    };
+
+    // Версии производных индексов. Индекс другой версии не используется, а пересчитывается,
+    // поэтому изменение индекса не требует смены FORMAT_VERSION
+    constexpr uint32_t STOP_ROUTES_VERSION = 1;
+    constexpr uint32_t ROUTE_INFOS_VERSION = 1;
+
+    struct FileHeader
+    {
+        char magic[8];
+        uint32_t byte_order;
+        uint32_t format_version;
+    };
+
+    struct SectionHeader
+    {
+        uint32_t id;
+        uint32_t reserved;
+        uint64_t size;
+    };
+
+    // Начало каждой производной секции: версия индекса и контрольная сумма следующих за ним данных
+    struct DerivedHeader
+    {
+        uint32_t version;
+        uint32_t reserved;
+        uint64_t checksum;
+    };
+
+    // Записи секций. Имена и остановки задаются смещениями и индексами, а не указателями
+    struct StopRecord
+    {
+        uint32_t name_offset;
+        uint32_t name_size;
+        double lat;
+        double lng;
+    };
+
+    struct RouteRecord
+    {
+        uint32_t name_offset;
+        uint32_t name_size;
+        // Диапазон в секции ROUTE_STOPS (индексы остановок, включая обратный путь)
+        uint32_t first_stop;
+        uint32_t stop_count;
+        uint32_t is_roundtrip;
+        uint32_t reserved;
+    };
+
+    struct DistanceRecord
+    {
+        uint32_t from;
+        uint32_t to;
+        double distance;
+    };
+
+    struct RouteInfoRecord
+    {
+        int32_t stops_count;
+        int32_t unique_stops_count;
+        double route_length;
+        double curvature;
+    };
+
+    // Массив записей, лежащий в памяти снимка (не владеет данными)
+    template <typename T>
+    struct Records
+    {
+        const T *data = nullptr;
+        size_t size = 0;
+
+        const T *begin() const { return data; }
+        const T *end() const { return data + size; }
+        const T &operator[](size_t index) const { return data[index]; }
+    };
+
+    // Секции снимка, уже находящиеся в памяти: прочитанные из потока или отображённые из файла
+    struct SnapshotView
+    {
+        std::string_view strings;
+        Records<StopRecord> stops;
+        Records<RouteRecord> routes;
+        Records<uint32_t> route_stops;
+        Records<DistanceRecord> distances;
+        std::string_view render_settings;
+        // Производные секции целиком, вместе с DerivedHeader. Проверяются при использовании
+        std::string_view stop_route_offsets;
+        std::string_view stop_routes;
+        std::string_view route_infos;
+    };
+
+    // Маршруты через остановку i: routes[offsets[i]] .. routes[offsets[i + 1] - 1]
+    struct StopRouteIndex
+    {
+        Records<uint32_t> offsets;
+        Records<uint32_t> routes;
+    };
+
+    // Контрольная сумма производных секций (FNV-1a, 64 бита)
+    uint64_t Checksum(std::string_view data);
+
+    // Производные индексы снимка. nullopt, если индекса нет, его версия отличается
+    // или он не согласован с основными секциями - тогда индекс нужно пересчитать
+    std::optional<StopRouteIndex> ReadStopRouteIndex(const SnapshotView &snapshot);
+    std::optional<Records<RouteInfoRecord>> ReadRouteInfos(const SnapshotView &snapshot);
+
+    // Пересчитывает маршруты через остановку по основным секциям
+    void ComputeStopRouteIndex(size_t stop_count, Records<RouteRecord> routes, Records<uint32_t> route_stops,
+                               std::vector<uint32_t> &offsets, std::vector<uint32_t> &stop_routes);
+
+    // Отметка порядка байтов в заголовке файла
+    constexpr uint32_t BYTE_ORDER_MARK = 0x01020304;
+
+    // Заголовок и секции файлов, общие для снимков и дельт
+    void WriteFileHeader(std::ostream &output, const char (&magic)[8], uint32_t format_version);
+    void WriteSection(std::ostream &output, uint32_t id, std::string_view data);
+    // Проверяет сигнатуру, порядок байтов и версию формата (FormatError)
+    void CheckFileHeader(const FileHeader &header, const char (&magic)[8], uint32_t format_version);
+    // То же для снимка каталога
+    void CheckFileHeader(const FileHeader &header);
+    // Проверяет размер секции по оставшейся длине потока до выделения под неё памяти (FormatError):
+    // повреждённый размер не должен приводить к выделению гигабайт. Для потоков без
+    // позиционирования проверка пропускается
+    void CheckSectionSize(std::istream &input, uint64_t size);
+
+    // Имя из пула строк (FormatError, если смещение выходит за пул)
+    std::string_view PoolString(std::string_view pool, uint32_t offset, uint32_t size);
+
+    // Заполняет пустой каталог остановками, маршрутами и расстояниями снимка.
+    // Пригодные производные индексы принимаются каталогом вместо построения
+    void BuildCatalogue(const SnapshotView &snapshot, transport_catalogue::TransportCatalogue &catalogue);
+
+    // Разбирает секцию настроек рендеринга
+    map_renderer::RenderSettings DecodeRenderSettings(std::string_view data);
+
+    // Сохраняет каталог и настройки рендеринга
+    void SaveCatalogue(std::ostream &output, const transport_catalogue::TransportCatalogue &catalogue,
+                       const map_renderer::RenderSettings &render_settings);
+    void SaveCatalogue(const std::string &path, const transport_catalogue::TransportCatalogue &catalogue,
+                       const map_renderer::RenderSettings &render_settings);
+
+    // Загружает снимок в пустой каталог и возвращает сохранённые настройки рендеринга
+    map_renderer::RenderSettings LoadCatalogue(std::istream &input, transport_catalogue::TransportCatalogue &catalogue);
+    map_renderer::RenderSettings LoadCatalogue(const std::string &path, transport_catalogue::TransportCatalogue &catalogue);
+
+} // namespace serialization
@@ -0,0 +1,1162 @@
+#include "server.h"
+
+#ifdef DEBUG_PRINT
+#undef DEBUG_PRINT
+#endif
+#define DEBUG_PRINT(x) \
+    do                 \
+    {                  \
+    } while (0)
+
+#include "http.h"
+#include "json_builder.h"
+#include "thread_pool.h"
+
+#include <stdexcept>
+
+#ifdef __linux__
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <sstream>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <chrono>
+#include <csignal>
+#include <fcntl.h>
+#include <iostream>
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
+#include <thread>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/prctl.h>
+#include <sys/signalfd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#endif
+
+namespace server
+{
+
+#ifdef __linux__
+
+    namespace
+    {
+        using namespace std::literals;
+
+        // Размер одного чтения из сокета
+        constexpr size_t READ_CHUNK_SIZE = 64 * 1024;
+        // Строка или тело запроса длиннее этого предела считается ошибкой клиента
+        constexpr size_t MAX_REQUEST_SIZE = 64 * 1024 * 1024;
+        constexpr size_t MAX_HTTP_HEAD_SIZE = 64 * 1024;
+        // Число строк одного соединения, выполняемых одновременно. Пока предел достигнут
+        // или не отправлено много ответов, соединение не читается
+        constexpr uint64_t MAX_IN_FLIGHT = 64;
+        constexpr size_t MAX_PENDING_OUTPUT = 16 * 1024 * 1024;
+        constexpr int MAX_EVENTS = 256;
+        // После завершения всех принятых запросов ответы досылаются медленным клиентам не дольше этого срока
+        constexpr std::chrono::seconds SHUTDOWN_FLUSH_TIMEOUT{5};
+
+        // Служебные дескрипторы в epoll помечаются ключами, не пересекающимися с номерами соединений
+        constexpr uint64_t SIGNAL_KEY = 0;
+        constexpr uint64_t WAKE_KEY = 1;
+        constexpr uint64_t FIRST_LISTENER_KEY = 2;
+        constexpr uint64_t FIRST_CONNECTION_KEY = 16;
+        constexpr size_t MAX_LISTENERS = FIRST_CONNECTION_KEY - FIRST_LISTENER_KEY;
+
+        // Рабочий процесс, завершившийся быстрее этого срока, перезапускается с задержкой,
+        // чтобы постоянный сбой при запуске не занимал супервизор целиком
+        constexpr std::chrono::seconds MIN_WORKER_LIFETIME{1};
+        constexpr std::chrono::seconds RESTART_DELAY{1};
+
+        constexpr std::string_view HTTP_CONTINUE = "HTTP/1.1 100 Continue\r\n\r\n"sv;
+
+        [[noreturn]] void ThrowSystemError(const std::string &what)
+        {
+            throw std::runtime_error(what + ": "s + std::strerror(errno));
+        }
+
+        // Владеющая обёртка дескриптора
+        class FileDescriptor
+        {
+        public:
+            explicit FileDescriptor(int fd = -1) : fd_(fd) {}
+
+            FileDescriptor(FileDescriptor &&other) noexcept : fd_(std::exchange(other.fd_, -1)) {}
+
+            FileDescriptor &operator=(FileDescriptor &&other) noexcept
+            {
+                if (this != &other)
+                {
+                    Reset(std::exchange(other.fd_, -1));
+                }
+                return *this;
+            }
+
+            ~FileDescriptor()
+            {
+                Reset();
+            }
+
+            void Reset(int fd = -1)
+            {
+                if (fd_ >= 0)
+                {
+                    ::close(fd_);
+                }
+                fd_ = fd;
+            }
+
+            int Get() const
+            {
+                return fd_;
+            }
+
+            int Release()
+            {
+                return std::exchange(fd_, -1);
+            }
+
+        private:
+            int fd_;
+        };
+
+        bool IsBlank(std::string_view line)
+        {
+            return line.find_first_not_of(" \t\r"sv) == std::string_view::npos;
+        }
+
+        // Тело ответа об ошибке в том же виде, что ошибки обработчика запросов
+        std::string ErrorBody(const std::string &message)
+        {
+            json::PrintOptions options;
+            options.compact = true;
+            std::ostringstream body;
+            json::StreamBuilder builder(body, options);
+            builder.StartDict().Key("error_message").Value(message).EndDict();
+            return std::move(body).str();
+        }
+
+        struct ListenSocket
+        {
+            int fd;
+            Protocol protocol;
+        };
+
+        // Ответ, выполненный в пуле потоков. Пустой ответ означает сбой обработчика
+        struct Completion
+        {
+            uint64_t connection;
+            uint64_t sequence;
+            std::optional<std::string> response;
+        };
+
+        struct Connection
+        {
+            FileDescriptor fd;
+            Protocol protocol = Protocol::LINES;
+            // Принятые байты. Разобранные запросы занимают начало буфера до input_pos
+            // и удаляются из него перед следующим чтением
+            std::string input;
+            size_t input_pos = 0;
+            // Позиция в неразобранных данных, с которой продолжается поиск конца запроса
+            size_t scan_pos = 0;
+            // Номер следующей выполняемой строки и следующего отправляемого ответа
+            uint64_t next_sequence = 0;
+            uint64_t next_to_send = 0;
+            // Ответы, выполненные раньше предыдущих
+            std::map<uint64_t, std::string> ready;
+            std::string output;
+            size_t output_pos = 0;
+            // Запросы больше не принимаются: клиент закрыл запись, запросил Connection: close
+            // или получил ответ об ошибке
+            bool read_closed = false;
+            // Размер уже полученного заголовка текущего запроса HTTP, тело которого ещё не получено
+            size_t head_size = 0;
+            // Для текущего запроса HTTP уже отправлен ответ 100 Continue
+            bool continue_sent = false;
+            uint32_t events = 0;
+
+            uint64_t InFlight() const
+            {
+                return next_sequence - next_to_send;
+            }
+
+            // Принятые, но ещё не выполняемые байты
+            std::string_view Pending() const
+            {
+                return std::string_view(input).substr(input_pos);
+            }
+
+            void Consume(size_t size)
+            {
+                input_pos += size;
+                scan_pos = 0;
+            }
+
+            void ClearInput()
+            {
+                input.clear();
+                input_pos = 0;
+                scan_pos = 0;
+            }
+
+            size_t PendingOutput() const
+            {
+                return output.size() - output_pos;
+            }
+        };
+
+        class EventLoop
+        {
+        public:
+            // shared_listeners - сокеты слушают и другие процессы
+            EventLoop(const Server::Handler &handler, size_t worker_count, std::vector<ListenSocket> listeners,
+                      bool shared_listeners = false)
+                : handler_(handler), worker_count_(worker_count), listeners_(std::move(listeners)),
+                  shared_listeners_(shared_listeners)
+            {
+            }
+
+            void Run()
+            {
+                // Сигналы завершения принимаются через signalfd. Маска наследуется потоками пула,
+                // поэтому устанавливается до их создания
+                sigset_t signals;
+                sigemptyset(&signals);
+                sigaddset(&signals, SIGINT);
+                sigaddset(&signals, SIGTERM);
+                sigset_t previous_signals;
+                pthread_sigmask(SIG_BLOCK, &signals, &previous_signals);
+                struct MaskRestorer
+                {
+                    const sigset_t &previous;
+                    ~MaskRestorer()
+                    {
+                        pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+                    }
+                } restorer{previous_signals};
+
+                epoll_ = FileDescriptor(::epoll_create1(EPOLL_CLOEXEC));
+                if (epoll_.Get() < 0)
+                {
+                    ThrowSystemError("Cannot create epoll instance"s);
+                }
+                signal_ = FileDescriptor(::signalfd(-1, &signals, SFD_NONBLOCK | SFD_CLOEXEC));
+                if (signal_.Get() < 0)
+                {
+                    ThrowSystemError("Cannot create signalfd"s);
+                }
+                wake_ = FileDescriptor(::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC));
+                if (wake_.Get() < 0)
+                {
+                    ThrowSystemError("Cannot create eventfd"s);
+                }
+                // Новое соединение будит только один из процессов, ожидающих на общем сокете
+                uint32_t listen_events = EPOLLIN;
+#ifdef EPOLLEXCLUSIVE
+                if (shared_listeners_)
+                {
+                    listen_events |= EPOLLEXCLUSIVE;
+                }
+#endif
+                for (size_t i = 0; i < listeners_.size(); ++i)
+                {
+                    Watch(listeners_[i].fd, FIRST_LISTENER_KEY + i, listen_events, EPOLL_CTL_ADD);
+                }
+                Watch(signal_.Get(), SIGNAL_KEY, EPOLLIN, EPOLL_CTL_ADD);
+                Watch(wake_.Get(), WAKE_KEY, EPOLLIN, EPOLL_CTL_ADD);
+
+                pool_ = std::make_unique<parallel::ThreadPool>(worker_count_);
+                Loop();
+                // Пул дожидается задач, ещё ссылающихся на очередь ответов
+                pool_.reset();
+            }
+
+        private:
+            void Loop()
+            {
+                epoll_event events[MAX_EVENTS];
+                std::optional<std::chrono::steady_clock::time_point> flush_deadline;
+                while (true)
+                {
+                    int timeout = -1;
+                    if (stopping_ && in_flight_ == 0)
+                    {
+                        // Все принятые запросы выполнены. Соединения закрываются по мере отправки ответов
+                        const auto now = std::chrono::steady_clock::now();
+                        if (!flush_deadline)
+                        {
+                            flush_deadline = now + SHUTDOWN_FLUSH_TIMEOUT;
+                        }
+                        if (connections_.empty() || now >= *flush_deadline)
+                        {
+                            break;
+                        }
+                        timeout = static_cast<int>(std::chrono::ceil<std::chrono::milliseconds>(*flush_deadline - now).count());
+                    }
+
+                    const int count = ::epoll_wait(epoll_.Get(), events, MAX_EVENTS, timeout);
+                    if (count < 0)
+                    {
+                        if (errno == EINTR)
+                        {
+                            continue;
+                        }
+                        ThrowSystemError("epoll_wait failed"s);
+                    }
+                    for (int i = 0; i < count; ++i)
+                    {
+                        const uint64_t key = events[i].data.u64;
+                        if (key >= FIRST_LISTENER_KEY && key < FIRST_CONNECTION_KEY)
+                        {
+                            Accept(listeners_[key - FIRST_LISTENER_KEY]);
+                        }
+                        else if (key == SIGNAL_KEY)
+                        {
+                            Stop();
+                        }
+                        else if (key == WAKE_KEY)
+                        {
+                            DrainCompletions();
+                        }
+                        else
+                        {
+                            HandleConnection(key, events[i].events);
+                        }
+                    }
+                }
+
+                // Срок истёк: оставшиеся ответы отправляются, если сокет готов их принять
+                for (auto &[key, connection] : connections_)
+                {
+                    Flush(connection);
+                }
+                connections_.clear();
+            }
+
+            void Watch(int fd, uint64_t key, uint32_t events, int operation)
+            {
+                epoll_event event = {};
+                event.events = events;
+                event.data.u64 = key;
+                if (::epoll_ctl(epoll_.Get(), operation, fd, &event) != 0)
+                {
+                    ThrowSystemError("epoll_ctl failed"s);
+                }
+            }
+
+            void Accept(const ListenSocket &listener)
+            {
+                while (!stopping_)
+                {
+                    const int fd = ::accept4(listener.fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+                    if (fd < 0)
+                    {
+                        // Ошибки отдельного соединения (например, клиент уже отключился) не останавливают сервер
+                        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                        {
+                            DEBUG_PRINT("accept failed: " << std::strerror(errno));
+                        }
+                        return;
+                    }
+                    if (listener.protocol == Protocol::HTTP)
+                    {
+                        // Ответы небольшие и отправляются сразу; для сокетов Unix параметр не применяется
+                        const int enable = 1;
+                        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+                    }
+                    const uint64_t key = next_key_++;
+                    Connection &connection = connections_[key];
+                    connection.fd.Reset(fd);
+                    connection.protocol = listener.protocol;
+                    connection.events = EPOLLIN;
+                    Watch(fd, key, connection.events, EPOLL_CTL_ADD);
+                    DEBUG_PRINT("Accepted connection " << key);
+                }
+            }
+
+            // Прекращает приём соединений и чтение запросов. Уже принятые запросы выполняются
+            void Stop()
+            {
+                signalfd_siginfo info;
+                while (::read(signal_.Get(), &info, sizeof(info)) > 0)
+                {
+                }
+                if (stopping_)
+                {
+                    return;
+                }
+                stopping_ = true;
+                for (const ListenSocket &listener : listeners_)
+                {
+                    ::epoll_ctl(epoll_.Get(), EPOLL_CTL_DEL, listener.fd, nullptr);
+                }
+                // Соединение закрывается, когда его запросы выполнены и ответы отправлены.
+                // До тех пор оно остаётся в epoll и ждёт готовности сокета к записи
+                std::vector<uint64_t> keys;
+                for (auto &[key, connection] : connections_)
+                {
+                    connection.read_closed = true;
+                    keys.push_back(key);
+                }
+                for (uint64_t key : keys)
+                {
+                    Connection &connection = connections_.at(key);
+                    if (!Flush(connection))
+                    {
+                        Close(key);
+                        continue;
+                    }
+                    Settle(key, connection);
+                }
+            }
+
+            void HandleConnection(uint64_t key, uint32_t events)
+            {
+                auto it = connections_.find(key);
+                if (it == connections_.end())
+                {
+                    return;
+                }
+                Connection &connection = it->second;
+
+                if (events & (EPOLLERR | EPOLLHUP) && !(events & EPOLLIN))
+                {
+                    Close(key);
+                    return;
+                }
+                if (events & EPOLLOUT && !Flush(connection))
+                {
+                    Close(key);
+                    return;
+                }
+                if (events & EPOLLIN && !Read(connection))
+                {
+                    Close(key);
+                    return;
+                }
+                if (!Dispatch(key, connection) || !Flush(connection))
+                {
+                    Close(key);
+                    return;
+                }
+                Settle(key, connection);
+            }
+
+            // Возвращает false, если соединение нужно закрыть
+            bool Read(Connection &connection)
+            {
+                // Разобранные запросы удаляются одним сдвигом на чтение, а не после каждого запроса
+                connection.input.erase(0, connection.input_pos);
+                connection.input_pos = 0;
+                const size_t size = connection.input.size();
+                connection.input.resize(size + READ_CHUNK_SIZE);
+                const ssize_t received = ::recv(connection.fd.Get(), connection.input.data() + size, READ_CHUNK_SIZE, 0);
+                connection.input.resize(size + std::max<ssize_t>(received, 0));
+                if (received == 0)
+                {
+                    connection.read_closed = true;
+                    return true;
+                }
+                if (received < 0)
+                {
+                    return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+                }
+                return true;
+            }
+
+            // Результат разбора очередного запроса соединения
+            enum class Step
+            {
+                // Запрос передан в пул или на него дан ответ, можно разбирать следующий
+                NEXT,
+                // Нужно дождаться данных или ответов на предыдущие запросы
+                WAIT,
+                // Соединение нужно закрыть
+                FAIL
+            };
+
+            // Передаёт в пул полностью полученные запросы соединения. Возвращает false,
+            // если соединение нужно закрыть
+            bool Dispatch(uint64_t key, Connection &connection)
+            {
+                Step step = Step::NEXT;
+                // После сигнала завершения новые запросы не выполняются
+                while (step == Step::NEXT && !stopping_ && connection.InFlight() < MAX_IN_FLIGHT)
+                {
+                    step = connection.protocol == Protocol::LINES ? NextLine(key, connection)
+                                                                  : NextHttpRequest(key, connection);
+                }
+                Collect(connection);
+                return step != Step::FAIL;
+            }
+
+            Step NextLine(uint64_t key, Connection &connection)
+            {
+                const std::string_view pending = connection.Pending();
+                const size_t end = pending.find('\n', connection.scan_pos);
+                if (end == std::string_view::npos)
+                {
+                    connection.scan_pos = pending.size();
+                    if (pending.size() > MAX_REQUEST_SIZE)
+                    {
+                        return Step::FAIL;
+                    }
+                    // Последняя строка без перевода строки выполняется после закрытия записи клиентом
+                    if (connection.read_closed && !IsBlank(pending))
+                    {
+                        Submit(key, connection, std::string(pending), false);
+                    }
+                    if (connection.read_closed)
+                    {
+                        connection.ClearInput();
+                    }
+                    return Step::WAIT;
+                }
+
+                std::string line(pending.substr(0, end));
+                connection.Consume(end + 1);
+                // Пустые строки пропускаются, как в режиме serve_lines
+                if (!IsBlank(line))
+                {
+                    Submit(key, connection, std::move(line), false);
+                }
+                return Step::NEXT;
+            }
+
+            Step NextHttpRequest(uint64_t key, Connection &connection)
+            {
+                const std::string_view pending = connection.Pending();
+                if (pending.empty())
+                {
+                    return Step::WAIT;
+                }
+                const size_t head_size = connection.head_size != 0 ? connection.head_size
+                                                                   : FindHttpHeadEnd(pending, connection.scan_pos);
+                if (head_size == std::string_view::npos)
+                {
+                    connection.scan_pos = pending.size();
+                    if (pending.size() > MAX_HTTP_HEAD_SIZE)
+                    {
+                        Reject(connection, 431, "Request header is too large");
+                    }
+                    else if (connection.read_closed)
+                    {
+                        // Клиент закрыл запись, не отправив запрос целиком
+                        connection.ClearInput();
+                    }
+                    return Step::WAIT;
+                }
+                connection.head_size = head_size;
+
+                HttpRequest request;
+                try
+                {
+                    request = ParseHttpHead(pending.substr(0, head_size));
+                }
+                catch (const HttpError &e)
+                {
+                    Reject(connection, e.GetStatus(), e.what());
+                    return Step::WAIT;
+                }
+                if (request.content_length > MAX_REQUEST_SIZE)
+                {
+                    Reject(connection, 413, "Request body is too large");
+                    return Step::WAIT;
+                }
+                if (pending.size() - head_size < request.content_length)
+                {
+                    // Клиент, ожидающий 100 Continue, отправит тело только после него
+                    if (request.expect_continue && !connection.continue_sent)
+                    {
+                        Respond(connection, std::string(HTTP_CONTINUE));
+                        connection.continue_sent = true;
+                    }
+                    if (connection.read_closed)
+                    {
+                        connection.ClearInput();
+                    }
+                    return Step::WAIT;
+                }
+
+                // Метод и цель запроса ссылаются на входной буфер, поэтому проверяются до его изменения
+                const bool found = request.target == "/"sv;
+                const bool allowed = request.method == "POST"sv;
+                const bool keep_alive = request.keep_alive;
+                std::string body(pending.substr(head_size, request.content_length));
+                connection.Consume(head_size + request.content_length);
+                connection.head_size = 0;
+                connection.continue_sent = false;
+                if (!keep_alive)
+                {
+                    connection.read_closed = true;
+                    connection.ClearInput();
+                }
+
+                if (!found)
+                {
+                    Respond(connection, FormatHttpResponse(404, ErrorBody("Not found"), keep_alive));
+                }
+                else if (!allowed)
+                {
+                    Respond(connection, FormatHttpResponse(405, ErrorBody("Only POST is allowed"), keep_alive));
+                }
+                else
+                {
+                    Submit(key, connection, std::move(body), keep_alive);
+                }
+                return keep_alive ? Step::NEXT : Step::WAIT;
+            }
+
+            // Отвечает на некорректный запрос HTTP и прекращает приём запросов соединения
+            void Reject(Connection &connection, int status, const std::string &message)
+            {
+                DEBUG_PRINT("Rejecting HTTP request: " << message);
+                Respond(connection, FormatHttpResponse(status, ErrorBody(message), false));
+                connection.read_closed = true;
+                connection.ClearInput();
+            }
+
+            // Ответ, сформированный без обработчика, занимает очередное место среди ответов соединения
+            void Respond(Connection &connection, std::string response)
+            {
+                connection.ready.emplace(connection.next_sequence++, std::move(response));
+            }
+
+            // Переносит в буфер отправки готовые ответы строго по порядку запросов
+            void Collect(Connection &connection)
+            {
+                for (auto ready = connection.ready.begin();
+                     ready != connection.ready.end() && ready->first == connection.next_to_send;
+                     ready = connection.ready.erase(ready))
+                {
+                    connection.output += ready->second;
+                    ++connection.next_to_send;
+                }
+            }
+
+            void Submit(uint64_t key, Connection &connection, std::string request, bool keep_alive)
+            {
+                const uint64_t sequence = connection.next_sequence++;
+                const Protocol protocol = connection.protocol;
+                ++in_flight_;
+                pool_->Submit([this, key, sequence, protocol, keep_alive, request = std::move(request)]
+                              {
+                                  Completion completion{key, sequence, std::nullopt};
+                                  try
+                                  {
+                                      std::string body;
+                                      int status = 200;
+                                      try
+                                      {
+                                          body = handler_(request);
+                                      }
+                                      catch (const std::exception &e)
+                                      {
+                                          DEBUG_PRINT("Request handler failed: " << e.what());
+                                          body = ErrorBody(e.what());
+                                          status = 500;
+                                      }
+                                      if (protocol == Protocol::LINES)
+                                      {
+                                          body.push_back('\n');
+                                          completion.response = std::move(body);
+                                      }
+                                      else
+                                      {
+                                          completion.response = FormatHttpResponse(status, body, keep_alive);
+                                      }
+                                  }
+                                  catch (...)
+                                  {
+                                      DEBUG_PRINT("Cannot format response");
+                                  }
+                                  Complete(std::move(completion)); });
+            }
+
+            // Вызывается в потоках пула
+            void Complete(Completion completion)
+            {
+                bool wake = false;
+                {
+                    std::lock_guard lock(completions_mutex_);
+                    wake = completions_.empty();
+                    completions_.push_back(std::move(completion));
+                }
+                if (wake)
+                {
+                    const uint64_t one = 1;
+                    [[maybe_unused]] const ssize_t written = ::write(wake_.Get(), &one, sizeof(one));
+                }
+            }
+
+            void DrainCompletions()
+            {
+                uint64_t counter = 0;
+                [[maybe_unused]] const ssize_t read = ::read(wake_.Get(), &counter, sizeof(counter));
+
+                std::vector<Completion> completions;
+                {
+                    std::lock_guard lock(completions_mutex_);
+                    completions.swap(completions_);
+                }
+
+                std::vector<uint64_t> touched;
+                for (Completion &completion : completions)
+                {
+                    --in_flight_;
+                    auto it = connections_.find(completion.connection);
+                    if (it == connections_.end())
+                    {
+                        continue;
+                    }
+                    Connection &connection = it->second;
+                    if (!completion.response)
+                    {
+                        // Следующие ответы уже не могут быть отправлены по порядку
+                        Close(completion.connection);
+                        continue;
+                    }
+                    connection.ready.emplace(completion.sequence, std::move(*completion.response));
+                    touched.push_back(completion.connection);
+                }
+
+                std::sort(touched.begin(), touched.end());
+                touched.erase(std::unique(touched.begin(), touched.end()), touched.end());
+                for (uint64_t key : touched)
+                {
+                    auto it = connections_.find(key);
+                    if (it == connections_.end())
+                    {
+                        continue;
+                    }
+                    Connection &connection = it->second;
+                    Collect(connection);
+                    if (!Dispatch(key, connection) || !Flush(connection))
+                    {
+                        Close(key);
+                        continue;
+                    }
+                    Settle(key, connection);
+                }
+            }
+
+            // Отправляет накопленные ответы, пока сокет их принимает. Возвращает false при ошибке
+            bool Flush(Connection &connection)
+            {
+                while (connection.PendingOutput() > 0)
+                {
+                    const ssize_t sent = ::send(connection.fd.Get(), connection.output.data() + connection.output_pos,
+                                                connection.PendingOutput(), MSG_NOSIGNAL);
+                    if (sent < 0)
+                    {
+                        if (errno == EINTR)
+                        {
+                            continue;
+                        }
+                        return errno == EAGAIN || errno == EWOULDBLOCK;
+                    }
+                    connection.output_pos += static_cast<size_t>(sent);
+                }
+                connection.output.clear();
+                connection.output_pos = 0;
+                return true;
+            }
+
+            // Закрывает завершённое соединение или обновляет набор ожидаемых событий
+            void Settle(uint64_t key, Connection &connection)
+            {
+                if (connection.read_closed && connection.InFlight() == 0 && connection.PendingOutput() == 0 &&
+                    (connection.Pending().empty() || stopping_))
+                {
+                    Close(key);
+                    return;
+                }
+                UpdateEvents(key, connection);
+            }
+
+            void UpdateEvents(uint64_t key, Connection &connection)
+            {
+                uint32_t events = 0;
+                if (!connection.read_closed && connection.InFlight() < MAX_IN_FLIGHT &&
+                    connection.PendingOutput() < MAX_PENDING_OUTPUT)
+                {
+                    events |= EPOLLIN;
+                }
+                if (connection.PendingOutput() > 0)
+                {
+                    events |= EPOLLOUT;
+                }
+                if (events != connection.events)
+                {
+                    connection.events = events;
+                    Watch(connection.fd.Get(), key, events, EPOLL_CTL_MOD);
+                }
+            }
+
+            // Ответы на запросы, ещё выполняемые в пуле, будут отброшены
+            void Close(uint64_t key)
+            {
+                DEBUG_PRINT("Closing connection " << key);
+                // Дескриптор удаляется из epoll при закрытии
+                connections_.erase(key);
+            }
+
+            const Server::Handler &handler_;
+            size_t worker_count_;
+            std::vector<ListenSocket> listeners_;
+            bool shared_listeners_;
+
+            FileDescriptor epoll_;
+            FileDescriptor signal_;
+            FileDescriptor wake_;
+
+            std::unordered_map<uint64_t, Connection> connections_;
+            uint64_t next_key_ = FIRST_CONNECTION_KEY;
+            // Число запросов всех соединений, переданных в пул и ещё не обработанных циклом
+            uint64_t in_flight_ = 0;
+            bool stopping_ = false;
+
+            std::mutex completions_mutex_;
+            std::vector<Completion> completions_;
+
+            // Объявлен последним: потоки пула останавливаются до разрушения очереди ответов
+            std::unique_ptr<parallel::ThreadPool> pool_;
+        };
+
+    } // namespace
+
+    Server::Server(Handler handler, size_t worker_count)
+        : handler_(std::move(handler)), worker_count_(std::max<size_t>(1, worker_count))
+    {
+    }
+
+    Server::~Server()
+    {
+        CloseListeners();
+    }
+
+    void Server::ListenUnix(const std::string &path, Protocol protocol)
+    {
+        if (listeners_.size() == MAX_LISTENERS)
+        {
+            throw std::logic_error("Too many listening sockets");
+        }
+        sockaddr_un address = {};
+        address.sun_family = AF_UNIX;
+        if (path.empty() || path.size() >= sizeof(address.sun_path))
+        {
+            throw std::invalid_argument("Invalid socket path: "s + path);
+        }
+        std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+        FileDescriptor fd(::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0));
+        if (fd.Get() < 0)
+        {
+            ThrowSystemError("Cannot create socket"s);
+        }
+
+        // Удаляется только файл сокета, обычный файл с тем же именем не трогается
+        struct stat info = {};
+        if (::lstat(path.c_str(), &info) == 0 && S_ISSOCK(info.st_mode))
+        {
+            ::unlink(path.c_str());
+        }
+        if (::bind(fd.Get(), reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0)
+        {
+            ThrowSystemError("Cannot bind socket "s + path);
+        }
+        if (::listen(fd.Get(), SOMAXCONN) != 0)
+        {
+            ::unlink(path.c_str());
+            ThrowSystemError("Cannot listen on socket "s + path);
+        }
+
+        listeners_.push_back({fd.Release(), protocol, path});
+        DEBUG_PRINT("Listening on " << path);
+    }
+
+    uint16_t Server::ListenTcp(const std::string &host, uint16_t port, Protocol protocol)
+    {
+        if (listeners_.size() == MAX_LISTENERS)
+        {
+            throw std::logic_error("Too many listening sockets");
+        }
+        sockaddr_in address = {};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        if (::inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1)
+        {
+            throw std::invalid_argument("Invalid IPv4 address: "s + host);
+        }
+
+        FileDescriptor fd(::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0));
+        if (fd.Get() < 0)
+        {
+            ThrowSystemError("Cannot create socket"s);
+        }
+        // Порт перезапущенного сервера не должен оставаться занятым соединениями в TIME_WAIT
+        const int enable = 1;
+        ::setsockopt(fd.Get(), SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+        if (::bind(fd.Get(), reinterpret_cast<const sockaddr *>(&address), sizeof(address)) != 0)
+        {
+            ThrowSystemError("Cannot bind "s + host + ":"s + std::to_string(port));
+        }
+        if (::listen(fd.Get(), SOMAXCONN) != 0)
+        {
+            ThrowSystemError("Cannot listen on "s + host + ":"s + std::to_string(port));
+        }
+
+        socklen_t size = sizeof(address);
+        if (::getsockname(fd.Get(), reinterpret_cast<sockaddr *>(&address), &size) != 0)
+        {
+            ThrowSystemError("Cannot get socket address"s);
+        }
+        listeners_.push_back({fd.Release(), protocol, {}});
+        DEBUG_PRINT("Listening on " << host << ":" << ntohs(address.sin_port));
+        return ntohs(address.sin_port);
+    }
+
+    void Server::Run()
+    {
+        if (listeners_.empty())
+        {
+            throw std::logic_error("Server is not listening");
+        }
+        std::vector<ListenSocket> listeners;
+        for (const Listener &listener : listeners_)
+        {
+            listeners.push_back({listener.fd, listener.protocol});
+        }
+        EventLoop(handler_, worker_count_, std::move(listeners)).Run();
+        CloseListeners();
+    }
+
+    void Server::RunProcesses(size_t process_count)
+    {
+        if (listeners_.empty())
+        {
+            throw std::logic_error("Server is not listening");
+        }
+
+        // Супервизор получает сигналы через signalfd. Маска наследуется рабочими процессами,
+        // поэтому сигналы, пришедшие до создания их собственного signalfd, не теряются
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+        sigaddset(&signals, SIGCHLD);
+        sigset_t previous_signals;
+        pthread_sigmask(SIG_BLOCK, &signals, &previous_signals);
+        struct MaskRestorer
+        {
+            const sigset_t &previous;
+            ~MaskRestorer()
+            {
+                pthread_sigmask(SIG_SETMASK, &previous, nullptr);
+            }
+        } restorer{previous_signals};
+
+        FileDescriptor signal_fd(::signalfd(-1, &signals, SFD_CLOEXEC));
+        if (signal_fd.Get() < 0)
+        {
+            ThrowSystemError("Cannot create signalfd"s);
+        }
+
+#ifdef __GLIBC__
+        // Свободные блоки кучи объединяются до fork. Иначе первое крупное выделение памяти
+        // в каждом рабочем процессе обошло бы их все и скопировало страницы, занятые каталогом
+        ::malloc_trim(0);
+#endif
+
+        using Clock = std::chrono::steady_clock;
+        std::unordered_map<pid_t, Clock::time_point> workers;
+        bool stopping = false;
+        auto stop = [&workers, &stopping]
+        {
+            stopping = true;
+            for (const auto &[pid, started] : workers)
+            {
+                ::kill(pid, SIGTERM);
+            }
+        };
+
+        try
+        {
+            for (size_t i = 0; i < std::max<size_t>(1, process_count); ++i)
+            {
+                workers.emplace(StartWorker(), Clock::now());
+            }
+        }
+        catch (...)
+        {
+            stop();
+            while (::waitpid(-1, nullptr, 0) > 0 || errno == EINTR)
+            {
+            }
+            throw;
+        }
+
+        while (!workers.empty())
+        {
+            signalfd_siginfo info;
+            if (::read(signal_fd.Get(), &info, sizeof(info)) != sizeof(info))
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                ThrowSystemError("Cannot read signal"s);
+            }
+            if (info.ssi_signo != SIGCHLD)
+            {
+                if (!stopping)
+                {
+                    stop();
+                }
+                continue;
+            }
+
+            // Сигналы SIGCHLD объединяются, поэтому собираются все завершившиеся процессы
+            int status = 0;
+            for (pid_t pid; (pid = ::waitpid(-1, &status, WNOHANG)) > 0;)
+            {
+                auto it = workers.find(pid);
+                if (it == workers.end())
+                {
+                    continue;
+                }
+                const Clock::duration lifetime = Clock::now() - it->second;
+                workers.erase(it);
+                if (stopping)
+                {
+                    continue;
+                }
+
+                if (WIFSIGNALED(status))
+                {
+                    std::cerr << "Worker " << pid << " terminated by signal " << WTERMSIG(status) << ", restarting" << std::endl;
+                }
+                else
+                {
+                    std::cerr << "Worker " << pid << " exited with status " << WEXITSTATUS(status) << ", restarting" << std::endl;
+                }
+                if (lifetime < MIN_WORKER_LIFETIME)
+                {
+                    std::this_thread::sleep_for(RESTART_DELAY);
+                }
+                workers.emplace(StartWorker(), Clock::now());
+            }
+        }
+        CloseListeners();
+    }
+
+    int Server::StartWorker()
+    {
+        const pid_t parent = ::getpid();
+        const pid_t pid = ::fork();
+        if (pid < 0)
+        {
+            ThrowSystemError("Cannot start worker process"s);
+        }
+        if (pid > 0)
+        {
+            DEBUG_PRINT("Started worker " << pid);
+            return pid;
+        }
+
+        // Рабочий процесс завершается вместе с супервизором, даже если тот был убит
+        ::prctl(PR_SET_PDEATHSIG, SIGTERM);
+        if (::getppid() != parent)
+        {
+            ::_exit(0);
+        }
+        int status = 0;
+        try
+        {
+            std::vector<ListenSocket> listeners;
+            for (const Listener &listener : listeners_)
+            {
+                listeners.push_back({listener.fd, listener.protocol});
+            }
+            EventLoop(handler_, worker_count_, std::move(listeners), true).Run();
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Worker " << ::getpid() << " failed: " << e.what() << std::endl;
+            status = 1;
+        }
+        // Деструкторы и обработчики atexit принадлежат супервизору: файлы сокетов удаляет он
+        ::_exit(status);
+    }
+
+    void Server::CloseListeners()
+    {
+        for (const Listener &listener : listeners_)
+        {
+            ::close(listener.fd);
+            if (!listener.path.empty())
+            {
+                ::unlink(listener.path.c_str());
+            }
+        }
+        listeners_.clear();
+    }
+
+#else
+
+    Server::Server(Handler handler, size_t worker_count)
+        : handler_(std::move(handler)), worker_count_(worker_count)
+    {
+    }
+
+    Server::~Server() = default;
+
+    void Server::ListenUnix(const std::string &path, Protocol)
+    {
+        throw std::runtime_error("Socket server is not supported on this platform: " + path);
+    }
+
+    uint16_t Server::ListenTcp(const std::string &host, uint16_t, Protocol)
+    {
+        throw std::runtime_error("Socket server is not supported on this platform: " + host);
+    }
+
+    void Server::Run()
+    {
+        throw std::runtime_error("Socket server is not supported on this platform");
+    }
+
+    void Server::RunProcesses(size_t)
+    {
+        throw std::runtime_error("Socket server is not supported on this platform");
+    }
+
+    int Server::StartWorker()
+    {
+        return -1;
+    }
+
+    void Server::CloseListeners()
+    {
+    }
+
+#endif
+
+} // namespace server
@@ -0,0 +1,90 @@
+#pragma once
+
+/*
+ * Сервер запросов на локальном сокете (Unix domain socket) и по HTTP.
+ *
+ * Каталог загружается один раз, после чего сервер обслуживает любое число одновременных
+ * соединений. Протокол строк тот же, что у режима serve_lines: каждая строка - запрос, пакет
+ * запросов или обновление base_requests, ответ - одна строка. По HTTP/1.1 тело запроса POST
+ * имеет тот же вид, что строка, а ответ передаётся телом ответа. Соединения HTTP остаются
+ * открытыми между запросами, запросы можно отправлять, не дожидаясь ответов.
+ * Ответы в пределах соединения выводятся в порядке запросов.
+ *
+ * Сокеты обслуживает один поток с циклом событий epoll, запросы выполняются в пуле потоков.
+ * Готовые ответы передаются циклу событий через eventfd. Сервер доступен только в Linux.
+ *
+ * В многопроцессном режиме (RunProcesses) обработчик и всё, что он использует, подготавливаются
+ * до запуска, после чего процесс-супервизор порождает рабочие процессы через fork. Они разделяют
+ * страницы родителя при копировании при записи и принимают соединения с общих сокетов.
+ */
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace server
+{
+
+    enum class Protocol
+    {
+        // Строка запроса - строка ответа
+        LINES,
+        // POST / с запросом в теле, ответ - application/json
+        HTTP
+    };
+
+    class Server
+    {
+    public:
+        // Возвращает ответ на запрос (строку или тело запроса HTTP) без перевода строки.
+        // Вызывается одновременно из нескольких потоков пула
+        using Handler = std::function<std::string(std::string_view request)>;
+
+        Server(Handler handler, size_t worker_count);
+
+        Server(const Server &) = delete;
+        Server &operator=(const Server &) = delete;
+
+        ~Server();
+
+        // Создаёт сокет по указанному пути. Оставшийся от прежнего запуска файл сокета заменяется
+        void ListenUnix(const std::string &path, Protocol protocol = Protocol::LINES);
+
+        // Принимает соединения TCP на адресе IPv4. Порт 0 выбирается системой.
+        // Возвращает фактический порт
+        uint16_t ListenTcp(const std::string &host, uint16_t port, Protocol protocol = Protocol::HTTP);
+
+        // Обслуживает соединения до SIGINT или SIGTERM, затем дожидается выполнения
+        // принятых запросов, закрывает соединения и удаляет файлы сокетов
+        void Run();
+
+        // То же в process_count рабочих процессах, каждый со своим циклом событий и пулом.
+        // Вызывающий процесс становится супервизором: перезапускает завершившиеся рабочие процессы,
+        // а по SIGINT или SIGTERM завершает их и дожидается окончания. Обработчик должен быть
+        // готов к работе до вызова и не должен изменять разделяемые данные, иначе их страницы
+        // копируются в каждый процесс
+        void RunProcesses(size_t process_count);
+
+    private:
+        struct Listener
+        {
+            int fd;
+            Protocol protocol;
+            // Путь сокета Unix, пустой для TCP
+            std::string path;
+        };
+
+        void CloseListeners();
+
+        // Запускает рабочий процесс и возвращает его идентификатор
+        int StartWorker();
+
+        Handler handler_;
+        size_t worker_count_;
+        std::vector<Listener> listeners_;
+    };
+
+} // namespace server
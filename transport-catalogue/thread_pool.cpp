@@ -0,0 +1,62 @@
+#include "thread_pool.h"
+
+#ifdef DEBUG_PRINT
+#undef DEBUG_PRINT
+#endif
+#define DEBUG_PRINT(x) \
+    do                 \
+    {                  \
+    } while (0)
+
+#include <algorithm>
+
+namespace parallel
+{
+
+    ThreadPool::ThreadPool(size_t thread_count)
+    {
+        thread_count = std::max<size_t>(1, thread_count);
+        workers_.reserve(thread_count);
+        for (size_t i = 0; i < thread_count; ++i)
+        {
+            workers_.emplace_back([this]
+                                  { Work(); });
+        }
+        DEBUG_PRINT("Thread pool started with " << thread_count << " threads");
+    }
+
+    ThreadPool::~ThreadPool()
+    {
+        {
+            std::lock_guard lock(mutex_);
+            stopping_ = true;
+        }
+        has_tasks_.notify_all();
+        for (std::thread &worker : workers_)
+        {
+            worker.join();
+        }
+    }
+
+    void ThreadPool::Work()
+    {
+        while (true)
+        {
+            std::function<void()> task;
+            {
+                std::unique_lock lock(mutex_);
+                has_tasks_.wait(lock, [this]
+                                { return stopping_ || !tasks_.empty(); });
+                if (tasks_.empty())
+                {
+                    return;
+                }
+                task = std::move(tasks_.front());
+                tasks_.pop_front();
+            }
+            // Исключения перехватывает packaged_task и передаёт в future
+            task();
+        }
+    }
+
+} // namespace parallel
@@ -0,0 +1,65 @@
+#pragma once
+
+/*
+ * Пул потоков фиксированного размера для выполнения независимых задач.
+ * Задачи выполняются в порядке постановки в очередь, результат возвращается через std::future.
+ */
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace parallel
+{
+
+    class ThreadPool
+    {
+    public:
+        explicit ThreadPool(size_t thread_count);
+
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+
+        // Дожидается выполнения уже поставленных задач и останавливает потоки
+        ~ThreadPool();
+
+        // Ставит задачу в очередь. Исключение, выброшенное задачей, пробрасывается из future::get
+        template <typename Func>
+        std::future<std::invoke_result_t<Func>> Submit(Func func)
+        {
+            using Result = std::invoke_result_t<Func>;
+            // std::function требует копируемого объекта, поэтому задача хранится по shared_ptr
+            auto task = std::make_shared<std::packaged_task<Result()>>(std::move(func));
+            std::future<Result> result = task->get_future();
+            {
+                std::lock_guard lock(mutex_);
+                tasks_.emplace_back([task]
+                                    { (*task)(); });
+            }
+            has_tasks_.notify_one();
+            return result;
+        }
+
+        size_t GetThreadCount() const
+        {
+            return workers_.size();
+        }
+
+    private:
+        void Work();
+
+        std::mutex mutex_;
+        std::condition_variable has_tasks_;
+        std::deque<std::function<void()>> tasks_;
+        bool stopping_ = false;
+        std::vector<std::thread> workers_;
+    };
+
+} // namespace parallel
@@ -1,4 +1,5 @@
 #include "transport_catalogue.h"
+#include "catalogue_image.h"
 #include "geo.h"
 
 #ifdef DEBUG_PRINT
@@ -9,154 +10,730 @@
     {                  \
     } while (0)
 
+#include "parallel.h"
+
 #include <algorithm>
+#include <functional>
+#include <stdexcept>
 #include <unordered_set>
 #include <iostream>
 
 namespace transport_catalogue
 {
 
-    void TransportCatalogue::InvalidateCache() const
+    namespace
+    {
+        // Минимальное число маршрутов на поток при построении индексов
+        constexpr size_t MIN_ROUTES_PER_THREAD = 64;
+    } // namespace
+
+    TransportCatalogue::TransportCatalogue(std::shared_ptr<const serialization::CatalogueImage> image)
+        : route_container_(&stop_container_), frozen_(true), image_(std::move(image))
     {
-        cache_valid_ = false;
-        DEBUG_PRINT("Invalidating cache");
+        // Индексы каталога из образа не строятся: запросы выполняются по образу
+        cache_valid_.store(true, std::memory_order_release);
+    }
+
+    TransportCatalogue::~TransportCatalogue() = default;
+
+    const TransportCatalogue &TransportCatalogue::Materialized() const
+    {
+        std::call_once(materialize_once_, [this]
+                       {
+                           DEBUG_PRINT("Materializing catalogue image");
+                           auto catalogue = std::make_unique<TransportCatalogue>();
+                           image_->LoadInto(*catalogue);
+                           catalogue->Freeze();
+                           materialized_ = std::move(catalogue); });
+        return *materialized_;
+    }
+
+    const domain::StopContainer &TransportCatalogue::GetStopContainer() const
+    {
+        return image_ ? Materialized().stop_container_ : stop_container_;
+    }
+
+    const domain::RouteContainer &TransportCatalogue::GetRouteContainer() const
+    {
+        return image_ ? Materialized().route_container_ : route_container_;
+    }
+
+    uint64_t TransportCatalogue::NextVersion()
+    {
+        // Номера общие для всех каталогов процесса, поэтому не повторяются
+        static std::atomic<uint64_t> next_version = 1;
+        return next_version.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void TransportCatalogue::CheckMutable() const
+    {
+        if (frozen_)
+        {
+            throw std::logic_error("Transport catalogue is frozen");
+        }
+    }
+
+    bool TransportCatalogue::IndexesBuilt() const
+    {
+        return cache_valid_.load(std::memory_order_acquire);
     }
 
     void TransportCatalogue::UpdateCache() const
     {
-        if (cache_valid_)
+        if (cache_valid_.load(std::memory_order_acquire))
         {
             DEBUG_PRINT("Cache is valid, skipping update");
             return;
         }
 
-        DEBUG_PRINT("Updating cache...");
+        // Индексы строит первый из читающих потоков, остальные дожидаются его на мьютексе
+        std::lock_guard lock(cache_mutex_);
+        if (!cache_valid_.load(std::memory_order_relaxed))
+        {
+            BuildIndexes(1);
+        }
+    }
+
+    void TransportCatalogue::Finalize(size_t thread_count)
+    {
+        CheckMutable();
+        std::lock_guard lock(cache_mutex_);
+        if (!cache_valid_.load(std::memory_order_relaxed))
+        {
+            BuildIndexes(thread_count);
+        }
+    }
+
+    void TransportCatalogue::AdoptIndexes(std::unordered_map<const Stop *, std::vector<std::string_view>> stop_routes,
+                                          std::unordered_map<const Route *, RouteInfo> route_infos)
+    {
+        CheckMutable();
+        std::lock_guard lock(cache_mutex_);
+        stop_to_routes_cache_ = std::move(stop_routes);
+        route_info_cache_ = std::move(route_infos);
+        cache_valid_.store(true, std::memory_order_release);
+        DEBUG_PRINT("Adopted indexes for " << stop_to_routes_cache_.size() << " stops");
+    }
+
+    void TransportCatalogue::Freeze(size_t thread_count)
+    {
+        std::lock_guard lock(cache_mutex_);
+        if (!cache_valid_.load(std::memory_order_relaxed))
+        {
+            BuildIndexes(thread_count);
+        }
+        frozen_ = true;
+        DEBUG_PRINT("Catalogue frozen");
+    }
+
+    void TransportCatalogue::BuildIndexes(size_t thread_count) const
+    {
+        DEBUG_PRINT("Building indexes in " << thread_count << " threads...");
+        const std::vector<const Route *> routes = route_container_.GetAllRoutes();
+        DEBUG_PRINT("Processing " << routes.size() << " routes for cache");
+
+        BuildStopIndex(routes, thread_count);
+
+        // Статистика маршрутов независима, каждый поток считает свою часть
+        std::vector<RouteInfo> infos(routes.size());
+        parallel::ForEachChunk(routes.size(), parallel::ThreadsFor(routes.size(), thread_count, MIN_ROUTES_PER_THREAD),
+                               [this, &routes, &infos](size_t, size_t begin, size_t end)
+                               {
+                                   for (size_t i = begin; i < end; ++i)
+                                   {
+                                       infos[i] = ComputeRouteInfo(routes[i]);
+                                   }
+                               });
+
+        route_info_cache_.clear();
+        route_info_cache_.reserve(routes.size());
+        for (size_t i = 0; i < routes.size(); ++i)
+        {
+            route_info_cache_.emplace(routes[i], infos[i]);
+        }
+
+        DEBUG_PRINT("Cache updated with " << stop_to_routes_cache_.size() << " stops");
+        cache_valid_.store(true, std::memory_order_release);
+    }
+
+    void TransportCatalogue::BuildStopIndex(const std::vector<const Route *> &routes, size_t thread_count) const
+    {
+        // Каждый маршрут пишет пары (остановка, маршрут) в свой заранее известный диапазон,
+        // поэтому заполнение не зависит от распределения маршрутов по потокам
+        std::vector<size_t> offsets(routes.size() + 1, 0);
+        for (size_t i = 0; i < routes.size(); ++i)
+        {
+            offsets[i + 1] = offsets[i] + routes[i]->stops.size();
+        }
+
+        using StopRoute = std::pair<const Stop *, std::string_view>;
+        std::vector<StopRoute> pairs(offsets.back());
+        parallel::ForEachChunk(routes.size(), parallel::ThreadsFor(routes.size(), thread_count, MIN_ROUTES_PER_THREAD),
+                               [&routes, &offsets, &pairs](size_t, size_t begin, size_t end)
+                               {
+                                   for (size_t i = begin; i < end; ++i)
+                                   {
+                                       size_t pos = offsets[i];
+                                       for (const Stop *stop : routes[i]->stops)
+                                       {
+                                           pairs[pos++] = {stop, routes[i]->name};
+                                       }
+                                   }
+                               });
+
+        // После сортировки маршруты каждой остановки идут подряд и упорядочены по имени
+        auto less = [](const StopRoute &lhs, const StopRoute &rhs)
+        {
+            if (lhs.first != rhs.first)
+            {
+                return std::less<const Stop *>{}(lhs.first, rhs.first);
+            }
+            return lhs.second < rhs.second;
+        };
+        parallel::Sort(pairs, thread_count, less);
+        pairs.erase(std::unique(pairs.begin(), pairs.end()), pairs.end());
+
         stop_to_routes_cache_.clear();
+        for (auto it = pairs.begin(); it != pairs.end();)
+        {
+            auto group_end = std::find_if(it, pairs.end(), [stop = it->first](const StopRoute &pair)
+                                          { return pair.first != stop; });
+            std::vector<std::string_view> &buses = stop_to_routes_cache_[it->first];
+            buses.reserve(group_end - it);
+            for (; it != group_end; ++it)
+            {
+                buses.push_back(it->second);
+            }
+        }
+    }
+
+    double TransportCatalogue::GetDistance(const std::string &from, const std::string &to) const
+    {
+        DEBUG_PRINT("GetDistance: " << from << " -> " << to);
+        if (image_)
+        {
+            const auto from_index = image_->FindStop(from);
+            const auto to_index = image_->FindStop(to);
+            return from_index && to_index ? image_->GetDistance(*from_index, *to_index) : 0.0;
+        }
+        return GetDistance(stop_container_.GetStop(from), stop_container_.GetStop(to));
+    }
 
-        auto all_routes = route_container_.GetAllRoutes();
-        DEBUG_PRINT("Processing " << all_routes.size() << " routes for cache");
+    double TransportCatalogue::GetDistance(const Stop *from, const Stop *to) const
+    {
+        if (image_)
+        {
+            return Materialized().GetDistance(from, to);
+        }
+        if (!from || !to)
+        {
+            DEBUG_PRINT("Cannot calculate distance: stops not found");
+            return 0.0;
+        }
 
-        for (const auto &route : all_routes)
+        auto it = distances_.find({from, to});
+        if (it != distances_.end())
         {
-            DEBUG_PRINT("Processing route '" << route->name << "' with " << route->stops.size() << " stops");
-            for (const auto &stop : route->stops)
+            DEBUG_PRINT("Found exact distance: " << it->second << "m");
+            return it->second;
+        }
+
+        // Если точное расстояние не найдено, проверяем обратное направление
+        it = distances_.find({to, from});
+        if (it != distances_.end())
+        {
+            DEBUG_PRINT("Found reverse distance: " << it->second << "m");
+            return it->second;
+        }
+
+        // Если обратное расстояние тоже не найдено, используем географическое расстояние
+        double geo_distance = geo::ComputeDistance(from->coordinates, to->coordinates);
+        DEBUG_PRINT("Using geographic distance: " << geo_distance << "m");
+        return geo_distance;
+    }
+
+    void TransportCatalogue::SetStop(std::string_view name, geo::Coordinates coordinates)
+    {
+        const Stop *existing = IndexesBuilt() ? stop_container_.GetStop(name) : nullptr;
+        stop_container_.AddStop(name, coordinates.lat, coordinates.lng);
+        if (existing)
+        {
+            RefreshRoutesThrough(existing);
+        }
+    }
+
+    void TransportCatalogue::SetDistance(std::string_view from, std::string_view to, double distance)
+    {
+        const Stop *from_stop = stop_container_.GetStop(from);
+        const Stop *to_stop = stop_container_.GetStop(to);
+        if (!from_stop || !to_stop)
+        {
+            DEBUG_PRINT("Skipping distance between unknown stops: " << from << " -> " << to);
+            return;
+        }
+        DEBUG_PRINT("Adding distance: " << from << " -> " << to << " = " << distance << "m");
+        StoreDistance(from_stop, to_stop, distance);
+
+        // Расстояние используется в обоих направлениях, но любой маршрут,
+        // содержащий этот перегон, проходит через from_stop
+        if (IndexesBuilt())
+        {
+            RefreshRoutesThrough(from_stop);
+        }
+    }
+
+    void TransportCatalogue::StoreDistance(const Stop *from, const Stop *to, double distance)
+    {
+        auto [it, inserted] = distances_.try_emplace({from, to}, distance);
+        if (!inserted)
+        {
+            it->second = distance;
+            return;
+        }
+        distance_neighbours_[from].push_back(to);
+        if (from != to)
+        {
+            distance_neighbours_[to].push_back(from);
+        }
+    }
+
+    void TransportCatalogue::UnlinkDistance(const Stop *stop, const Stop *neighbour)
+    {
+        auto it = distance_neighbours_.find(stop);
+        if (it == distance_neighbours_.end())
+        {
+            return;
+        }
+        std::vector<const Stop *> &neighbours = it->second;
+        auto pos = std::find(neighbours.begin(), neighbours.end(), neighbour);
+        if (pos != neighbours.end())
+        {
+            *pos = neighbours.back();
+            neighbours.pop_back();
+        }
+        if (neighbours.empty())
+        {
+            distance_neighbours_.erase(it);
+        }
+    }
+
+    bool TransportCatalogue::IsStopUsed(const Stop *stop) const
+    {
+        if (IndexesBuilt())
+        {
+            return stop_to_routes_cache_.count(stop) != 0;
+        }
+        // Строить индексы ради одной проверки дороже, чем просмотреть маршруты
+        const std::vector<const Route *> routes = route_container_.GetAllRoutes();
+        return std::any_of(routes.begin(), routes.end(), [stop](const Route *route)
+                           { return std::find(route->stops.begin(), route->stops.end(), stop) != route->stops.end(); });
+    }
+
+    void TransportCatalogue::InsertRoute(std::unique_ptr<Route> route)
+    {
+        const bool indexes_built = IndexesBuilt();
+        if (indexes_built)
+        {
+            // Заменяемый маршрут убирается из индексов, пока его имя ещё существует
+            if (const Route *old_route = route_container_.GetRoute(route->name))
             {
-                stop_to_routes_cache_[stop->name].push_back(route->name);
-                DEBUG_PRINT("Added route '" << route->name << "' to stop '" << stop->name << "'");
+                UnindexRoute(old_route);
             }
         }
 
-        // Удаляем дубликаты маршрутов для каждой остановки
-        for (auto &[stop_name, routes] : stop_to_routes_cache_)
+        const Route *inserted = route.get();
+        route_container_.Add(std::move(route));
+        if (indexes_built)
+        {
+            IndexRoute(inserted);
+        }
+    }
+
+    void TransportCatalogue::IndexRoute(const Route *route)
+    {
+        for (const Stop *stop : route->stops)
         {
-            auto original_size = routes.size();
-            std::sort(routes.begin(), routes.end());
-            routes.erase(std::unique(routes.begin(), routes.end()), routes.end());
-            if (original_size != routes.size())
+            std::vector<std::string_view> &buses = stop_to_routes_cache_[stop];
+            auto it = std::lower_bound(buses.begin(), buses.end(), std::string_view(route->name));
+            if (it == buses.end() || *it != route->name)
             {
-                DEBUG_PRINT("Removed " << (original_size - routes.size()) << " duplicates for stop '" << stop_name << "'");
+                buses.insert(it, route->name);
             }
         }
+        route_info_cache_[route] = ComputeRouteInfo(route);
+    }
 
-        DEBUG_PRINT("Cache updated with " << stop_to_routes_cache_.size() << " stops");
-        cache_valid_ = true;
+    void TransportCatalogue::UnindexRoute(const Route *route)
+    {
+        for (const Stop *stop : route->stops)
+        {
+            auto buses_it = stop_to_routes_cache_.find(stop);
+            if (buses_it == stop_to_routes_cache_.end())
+            {
+                continue;
+            }
+            std::vector<std::string_view> &buses = buses_it->second;
+            auto it = std::lower_bound(buses.begin(), buses.end(), std::string_view(route->name));
+            if (it != buses.end() && *it == route->name)
+            {
+                buses.erase(it);
+            }
+            if (buses.empty())
+            {
+                stop_to_routes_cache_.erase(buses_it);
+            }
+        }
+        route_info_cache_.erase(route);
     }
 
-    double TransportCatalogue::GetDistance(const std::string &from, const std::string &to) const
+    void TransportCatalogue::RefreshRoutesThrough(const Stop *stop)
     {
-        DEBUG_PRINT("GetDistance: " << from << " -> " << to);
+        auto it = stop_to_routes_cache_.find(stop);
+        if (it == stop_to_routes_cache_.end())
+        {
+            return;
+        }
+        for (std::string_view bus_name : it->second)
+        {
+            const Route *route = route_container_.GetRoute(bus_name);
+            route_info_cache_[route] = ComputeRouteInfo(route);
+        }
+        DEBUG_PRINT("Refreshed " << it->second.size() << " routes through '" << stop->name << "'");
+    }
 
-        auto from_it = distances_.find(from);
-        if (from_it != distances_.end())
+    bool TransportCatalogue::UpdateStop(std::string_view name, geo::Coordinates coordinates)
+    {
+        CheckMutable();
+        if (!stop_container_.SetCoordinates(name, coordinates))
+        {
+            return false;
+        }
+        version_ = NextVersion();
+        if (IndexesBuilt())
+        {
+            RefreshRoutesThrough(stop_container_.GetStop(name));
+        }
+        return true;
+    }
+
+    bool TransportCatalogue::RemoveStop(std::string_view name)
+    {
+        CheckMutable();
+        const Stop *stop = stop_container_.GetStop(name);
+        if (!stop)
         {
-            auto to_it = from_it->second.find(to);
-            if (to_it != from_it->second.end())
+            return false;
+        }
+
+        if (IsStopUsed(stop))
+        {
+            throw std::logic_error("Stop '" + std::string(name) + "' is used by routes");
+        }
+
+        // Удаляются только расстояния самой остановки, известные по списку соседей
+        auto neighbours_it = distance_neighbours_.find(stop);
+        if (neighbours_it != distance_neighbours_.end())
+        {
+            for (const Stop *neighbour : neighbours_it->second)
             {
-                DEBUG_PRINT("Found exact distance: " << to_it->second << "m");
-                return to_it->second;
+                distances_.erase({stop, neighbour});
+                distances_.erase({neighbour, stop});
+                if (neighbour != stop)
+                {
+                    UnlinkDistance(neighbour, stop);
+                }
             }
+            distance_neighbours_.erase(stop);
         }
+        stop_to_routes_cache_.erase(stop);
+        stop_container_.Remove(name);
+        version_ = NextVersion();
+        return true;
+    }
 
-        // Если точное расстояние не найдено, проверяем обратное направление
-        auto to_it = distances_.find(to);
-        if (to_it != distances_.end())
+    bool TransportCatalogue::RemoveRoute(std::string_view name)
+    {
+        CheckMutable();
+        const Route *route = route_container_.GetRoute(name);
+        if (!route)
+        {
+            return false;
+        }
+        if (IndexesBuilt())
+        {
+            UnindexRoute(route);
+        }
+        route_container_.Remove(name);
+        version_ = NextVersion();
+        return true;
+    }
+
+    bool TransportCatalogue::RemoveDistance(std::string_view from, std::string_view to)
+    {
+        CheckMutable();
+        const Stop *from_stop = stop_container_.GetStop(from);
+        const Stop *to_stop = stop_container_.GetStop(to);
+        if (!from_stop || !to_stop || distances_.erase({from_stop, to_stop}) == 0)
+        {
+            return false;
+        }
+        UnlinkDistance(from_stop, to_stop);
+        if (from_stop != to_stop)
+        {
+            UnlinkDistance(to_stop, from_stop);
+        }
+        version_ = NextVersion();
+        if (IndexesBuilt())
+        {
+            RefreshRoutesThrough(from_stop);
+        }
+        return true;
+    }
+
+    std::unique_ptr<TransportCatalogue> TransportCatalogue::Clone() const
+    {
+        DEBUG_PRINT("Cloning catalogue");
+        if (image_)
+        {
+            return Materialized().Clone();
+        }
+        auto copy = std::make_unique<TransportCatalogue>();
+        const std::vector<const Stop *> stops = stop_container_.GetAllStops();
+        const std::vector<const Route *> routes = route_container_.GetAllRoutes();
+        copy->Reserve(stops.size(), routes.size(), distances_.size());
+
+        // Маршруты и расстояния ссылаются на остановки по указателю,
+        // поэтому их ссылки переводятся на остановки копии
+        std::unordered_map<const Stop *, const Stop *> stop_map;
+        stop_map.reserve(stops.size());
+        for (const Stop *stop : stops)
+        {
+            copy->stop_container_.AddStop(stop->name, stop->coordinates.lat, stop->coordinates.lng);
+            stop_map.emplace(stop, copy->stop_container_.GetStop(stop->name));
+        }
+
+        for (const Route *route : routes)
         {
-            auto from_it_reverse = to_it->second.find(from);
-            if (from_it_reverse != to_it->second.end())
+            auto route_copy = std::make_unique<Route>();
+            route_copy->name = route->name;
+            route_copy->is_roundtrip = route->is_roundtrip;
+            route_copy->stops.reserve(route->stops.size());
+            for (const Stop *stop : route->stops)
             {
-                DEBUG_PRINT("Found reverse distance: " << from_it_reverse->second << "m");
-                return from_it_reverse->second;
+                route_copy->stops.push_back(stop_map.at(stop));
             }
+            copy->route_container_.Add(std::move(route_copy));
         }
 
-        // Если обратное расстояние тоже не найдено, используем географическое расстояние
-        auto from_stop = stop_container_.GetStop(from);
-        auto to_stop = stop_container_.GetStop(to);
+        for (const auto &[stops_pair, distance] : distances_)
+        {
+            copy->StoreDistance(stop_map.at(stops_pair.first), stop_map.at(stops_pair.second), distance);
+        }
 
-        if (from_stop && to_stop)
+        // Индексы переносятся, чтобы изменения копии не требовали их полного перестроения
+        if (IndexesBuilt())
         {
-            double geo_distance = geo::ComputeDistance(from_stop->coordinates, to_stop->coordinates);
-            DEBUG_PRINT("Using geographic distance: " << geo_distance << "m");
-            return geo_distance;
+            copy->stop_to_routes_cache_.reserve(stop_to_routes_cache_.size());
+            for (const auto &[stop, buses] : stop_to_routes_cache_)
+            {
+                std::vector<std::string_view> &buses_copy = copy->stop_to_routes_cache_[stop_map.at(stop)];
+                buses_copy.reserve(buses.size());
+                for (std::string_view bus_name : buses)
+                {
+                    buses_copy.push_back(copy->route_container_.GetRoute(bus_name)->name);
+                }
+            }
+            copy->route_info_cache_.reserve(route_info_cache_.size());
+            for (const auto &[route, info] : route_info_cache_)
+            {
+                copy->route_info_cache_.emplace(copy->route_container_.GetRoute(route->name), info);
+            }
+            copy->cache_valid_.store(true, std::memory_order_release);
         }
+        copy->version_ = version_;
+        return copy;
+    }
 
-        DEBUG_PRINT("Cannot calculate distance: stops not found");
-        return 0.0;
+    void TransportCatalogue::Reserve(size_t stop_count, size_t route_count, size_t distance_count)
+    {
+        CheckMutable();
+        DEBUG_PRINT("Reserve: " << stop_count << " stops, " << route_count << " routes, " << distance_count << " distances");
+        stop_container_.Reserve(stop_count);
+        route_container_.Reserve(route_count);
+        distances_.reserve(distance_count);
     }
 
     void TransportCatalogue::AddStops(const std::vector<std::pair<std::string, std::pair<double, double>>> &stops)
     {
+        CheckMutable();
         DEBUG_PRINT("AddStops: adding " << stops.size() << " stops");
         for (const auto &[name, coords] : stops)
         {
             DEBUG_PRINT("Adding stop: " << name << " (" << coords.first << ", " << coords.second << ")");
-            stop_container_.AddStop(name, coords.first, coords.second);
+            SetStop(name, {coords.first, coords.second});
+        }
+        version_ = NextVersion();
+    }
+
+    void TransportCatalogue::AddStops(const std::vector<StopInput> &stops)
+    {
+        CheckMutable();
+        DEBUG_PRINT("AddStops: adding " << stops.size() << " stops");
+        for (const StopInput &stop : stops)
+        {
+            SetStop(stop.name, stop.coordinates);
         }
-        InvalidateCache();
+        version_ = NextVersion();
     }
 
     void TransportCatalogue::AddRoute(const std::string &name, const std::vector<std::string> &stops, bool is_roundtrip)
     {
+        CheckMutable();
+        DEBUG_PRINT("AddRoute: " << name << " with " << stops.size() << " stops, roundtrip: " << is_roundtrip);
+        InsertRoute(route_container_.MakeRoute(name, stops, is_roundtrip));
+        version_ = NextVersion();
+    }
+
+    void TransportCatalogue::AddRoute(std::string_view name, const std::vector<std::string_view> &stops, bool is_roundtrip)
+    {
+        CheckMutable();
         DEBUG_PRINT("AddRoute: " << name << " with " << stops.size() << " stops, roundtrip: " << is_roundtrip);
-        route_container_.AddRoute(name, stops, is_roundtrip);
-        InvalidateCache();
+        InsertRoute(route_container_.MakeRoute(name, stops, is_roundtrip));
+        version_ = NextVersion();
+    }
+
+    void TransportCatalogue::AddRoutes(const std::vector<RouteInput> &routes, size_t thread_count)
+    {
+        CheckMutable();
+        DEBUG_PRINT("AddRoutes: adding " << routes.size() << " routes in " << thread_count << " threads");
+
+        // Остановки только читаются, поэтому маршруты можно строить параллельно
+        std::vector<std::unique_ptr<Route>> built(routes.size());
+        parallel::ForEachChunk(routes.size(), parallel::ThreadsFor(routes.size(), thread_count, MIN_ROUTES_PER_THREAD),
+                               [this, &routes, &built](size_t, size_t begin, size_t end)
+                               {
+                                   for (size_t i = begin; i < end; ++i)
+                                   {
+                                       built[i] = route_container_.MakeRoute(routes[i].name, routes[i].stops, routes[i].is_roundtrip);
+                                   }
+                               });
+
+        for (std::unique_ptr<Route> &route : built)
+        {
+            InsertRoute(std::move(route));
+        }
+        version_ = NextVersion();
+    }
+
+    void TransportCatalogue::AddPreparedRoutes(std::vector<std::unique_ptr<Route>> routes)
+    {
+        CheckMutable();
+        DEBUG_PRINT("AddPreparedRoutes: adding " << routes.size() << " routes");
+        for (std::unique_ptr<Route> &route : routes)
+        {
+            InsertRoute(std::move(route));
+        }
+        version_ = NextVersion();
+    }
+
+    void TransportCatalogue::AddDistance(const Stop *from, const Stop *to, double distance)
+    {
+        CheckMutable();
+        StoreDistance(from, to, distance);
+        if (IndexesBuilt())
+        {
+            RefreshRoutesThrough(from);
+        }
+        version_ = NextVersion();
     }
 
     void TransportCatalogue::AddDistances(const std::vector<std::tuple<std::string, std::string, double>> &distances)
     {
+        CheckMutable();
         DEBUG_PRINT("AddDistances: adding " << distances.size() << " distances");
         for (const auto &[from, to, distance] : distances)
         {
-            DEBUG_PRINT("Adding distance: " << from << " -> " << to << " = " << distance << "m");
-            distances_[from][to] = distance;
+            SetDistance(from, to, distance);
+        }
+        version_ = NextVersion();
+    }
+
+    void TransportCatalogue::AddDistances(const std::vector<DistanceInput> &distances)
+    {
+        CheckMutable();
+        DEBUG_PRINT("AddDistances: adding " << distances.size() << " distances");
+        for (const DistanceInput &distance : distances)
+        {
+            SetDistance(distance.from, distance.to, distance.distance);
         }
+        version_ = NextVersion();
     }
 
     std::vector<std::string> TransportCatalogue::GetStopInfo(const std::string &stop_name) const
     {
         DEBUG_PRINT("GetStopInfo: " << stop_name);
-        UpdateCache();
+        if (image_)
+        {
+            std::vector<std::string> result;
+            ForEachBusByStop(stop_name, [&result](std::string_view bus)
+                             { result.emplace_back(bus); });
+            return result;
+        }
+
+        const std::vector<std::string_view> &buses = GetBusesByStop(stop_name);
+        DEBUG_PRINT("Found " << buses.size() << " routes for stop '" << stop_name << "'");
+        return {buses.begin(), buses.end()};
+    }
 
-        auto it = stop_to_routes_cache_.find(stop_name);
-        if (it != stop_to_routes_cache_.end())
+    const std::vector<std::string_view> &TransportCatalogue::GetBusesByStop(std::string_view stop_name) const
+    {
+        static const std::vector<std::string_view> empty;
+        if (image_)
         {
-            DEBUG_PRINT("Found " << it->second.size() << " routes for stop '" << stop_name << "'");
-            return it->second;
+            return Materialized().GetBusesByStop(stop_name);
         }
+        UpdateCache();
+
+        auto it = stop_to_routes_cache_.find(stop_container_.GetStop(stop_name));
+        return it != stop_to_routes_cache_.end() ? it->second : empty;
+    }
 
-        DEBUG_PRINT("No routes found for stop '" << stop_name << "'");
-        return {};
+    void TransportCatalogue::ForEachBusByStop(std::string_view stop_name,
+                                              const std::function<void(std::string_view)> &func) const
+    {
+        if (image_)
+        {
+            if (const auto stop = image_->FindStop(stop_name))
+            {
+                image_->ForEachRouteThrough(*stop, func);
+            }
+            return;
+        }
+        for (std::string_view bus : GetBusesByStop(stop_name))
+        {
+            func(bus);
+        }
     }
 
     const Stop *TransportCatalogue::GetStopByName(const std::string &stop_name) const
     {
         DEBUG_PRINT("GetStopByName (coordinates): " << stop_name);
-        return stop_container_.GetStop(stop_name);
+        return GetStopContainer().GetStop(stop_name);
+    }
+
+    bool TransportCatalogue::StopExists(std::string_view stop_name) const
+    {
+        return image_ ? image_->FindStop(stop_name).has_value() : stop_container_.Exists(stop_name);
     }
 
     RouteInfo TransportCatalogue::GetRouteInfo(const std::string &route_name) const
     {
         DEBUG_PRINT("GetRouteInfo: " << route_name);
+        if (image_)
+        {
+            const auto route = image_->FindRoute(route_name);
+            return route ? image_->GetRouteInfo(*route) : RouteInfo{0, 0, 0.0, 0.0};
+        }
 
         auto route = route_container_.GetRoute(route_name);
         if (!route)
@@ -165,16 +742,18 @@ namespace transport_catalogue
             return {0, 0, 0.0, 0.0};
         }
 
+        UpdateCache();
+        return route_info_cache_.at(route);
+    }
+
+    RouteInfo TransportCatalogue::ComputeRouteInfo(const Route *route) const
+    {
         RouteInfo info;
         info.stops_count = route->stops.size();
         DEBUG_PRINT("Total stops: " << info.stops_count);
 
         // Подсчитываем уникальные остановки
-        std::unordered_set<std::string> unique_stops;
-        for (const auto &stop : route->stops)
-        {
-            unique_stops.insert(stop->name);
-        }
+        std::unordered_set<const Stop *> unique_stops(route->stops.begin(), route->stops.end());
         info.unique_stops_count = unique_stops.size();
         DEBUG_PRINT("Unique stops: " << info.unique_stops_count);
 
@@ -185,7 +764,7 @@ namespace transport_catalogue
             double total_length = 0.0;
             for (size_t i = 0; i < route->stops.size() - 1; ++i)
             {
-                double segment_length = GetDistance(route->stops[i]->name, route->stops[i + 1]->name);
+                double segment_length = GetDistance(route->stops[i], route->stops[i + 1]);
                 total_length += segment_length;
                 DEBUG_PRINT("Segment " << i << ": " << route->stops[i]->name
                                        << " -> " << route->stops[i + 1]->name << " = " << segment_length << "m");
@@ -195,7 +774,7 @@ namespace transport_catalogue
 
             // Вычисляем кривизну маршрута
             double straight_length;
-            if (route->stops.front()->name == route->stops.back()->name)
+            if (route->stops.front() == route->stops.back())
             {
                 // Для кольцевого маршрута используем длину по периметру многоугольника
                 straight_length = 0.0;
@@ -226,7 +805,7 @@ namespace transport_catalogue
     bool TransportCatalogue::RouteExists(const std::string &route_name) const
     {
         DEBUG_PRINT("RouteExists: " << route_name);
-        return route_container_.Exists(route_name);
+        return image_ ? image_->FindRoute(route_name).has_value() : route_container_.Exists(route_name);
     }
 
 } // namespace transport_catalogue
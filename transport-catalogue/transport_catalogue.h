@@ -1,9 +1,20 @@
 #pragma once
 
 #include "domain.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <string>
+#include <string_view>
 #include <unordered_map>
+#include <utility>
+
+namespace serialization {
+class CatalogueImage;
+} // namespace serialization
 
 namespace transport_catalogue {
 
@@ -14,53 +25,200 @@ struct RouteInfo {
     double curvature;
 };
 
+// Описания для пакетной загрузки без копирования строк: представления должны
+// ссылаться на данные, живущие до конца вызова. Имена копируются в каталог ровно один раз
+struct StopInput {
+    std::string_view name;
+    geo::Coordinates coordinates;
+};
+
+struct DistanceInput {
+    std::string_view from;
+    std::string_view to;
+    double distance;
+};
+
+struct RouteInput {
+    std::string_view name;
+    std::vector<std::string_view> stops;
+    bool is_roundtrip = false;
+};
+
+// Потокобезопасность:
+// - изменяющие методы (Add*, Update*, Remove*, Reserve, Finalize, Freeze) нельзя вызывать
+//   одновременно с любыми другими методами;
+// - константные методы можно вызывать из любого числа потоков одновременно. Производные
+//   индексы строятся при первом обращении под мьютексом, далее читаются без блокировок;
+// - после Freeze индексы построены, каталог неизменяем (изменяющие методы выбрасывают
+//   std::logic_error), и чтение никогда не блокируется.
 class TransportCatalogue {
 public:
     TransportCatalogue() : route_container_(&stop_container_) {}
     
+    // Неизменяемый каталог поверх отображённого в память образа. Запросы об остановках
+    // и маршрутах выполняются прямо по образу; методы, возвращающие объекты предметной
+    // области (контейнеры, GetStopByName, GetBusesByStop, Clone), при первом обращении
+    // строят полную копию образа в памяти
+    explicit TransportCatalogue(std::shared_ptr<const serialization::CatalogueImage> image);
+    ~TransportCatalogue();
+    
+    // Независимая изменяемая копия каталога. Построенные индексы копируются,
+    // поэтому последующие изменения копии обновляют их инкрементально. Само копирование
+    // занимает время и память, пропорциональные размеру всего каталога
+    std::unique_ptr<TransportCatalogue> Clone() const;
+    
+    // Резервирование места под ожидаемое число остановок, маршрутов и расстояний
+    void Reserve(size_t stop_count, size_t route_count, size_t distance_count = 0);
+    
     // Добавление остановок из списка инициализации
     void AddStops(const std::vector<std::pair<std::string, std::pair<double, double>>>& stops);
+    void AddStops(const std::vector<StopInput>& stops);
     
-    // Добавление одного маршрута
+    // Добавление одного маршрута. Маршрут с тем же именем заменяется
     void AddRoute(const std::string& name, const std::vector<std::string>& stops, bool is_roundtrip = false);
+    void AddRoute(std::string_view name, const std::vector<std::string_view>& stops, bool is_roundtrip = false);
+    
+    // Пакетное добавление маршрутов: имена остановок разрешаются в thread_count потоках,
+    // маршруты вставляются в исходном порядке
+    void AddRoutes(const std::vector<RouteInput>& routes, size_t thread_count = 1);
     
-    // Добавление расстояний между остановками
+    // Добавление расстояний между остановками. Остановки должны быть уже добавлены,
+    // расстояния до неизвестных остановок пропускаются
     void AddDistances(const std::vector<std::tuple<std::string, std::string, double>>& distances);
+    void AddDistances(const std::vector<DistanceInput>& distances);
+    
+    // Добавление уже разрешённых данных (например, при загрузке снимка):
+    // маршруты и расстояния должны ссылаться на остановки этого каталога
+    void AddPreparedRoutes(std::vector<std::unique_ptr<Route>> routes);
+    void AddDistance(const Stop* from, const Stop* to, double distance);
+    
+    // Изменение и удаление. Построенные индексы обновляются только для затронутых
+    // остановок и маршрутов. Методы возвращают false, если объекта нет в каталоге
+    bool UpdateStop(std::string_view name, geo::Coordinates coordinates);
+    // Остановку, через которую проходят маршруты, удалить нельзя (std::logic_error)
+    bool RemoveStop(std::string_view name);
+    bool RemoveRoute(std::string_view name);
+    bool RemoveDistance(std::string_view from, std::string_view to);
+    
+    // Номер изменения: уникален в пределах процесса и меняется при каждом изменении каталога.
+    // Копия (Clone) получает номер оригинала, поэтому равные номера означают одинаковое
+    // содержимое, и по номеру можно кэшировать результаты, зависящие от каталога
+    uint64_t GetVersion() const { return version_; }
     
     // Получение информации об остановке
     std::vector<std::string> GetStopInfo(const std::string& stop_name) const;
     
+    // Маршруты, проходящие через остановку, без копирования.
+    // Ссылка действительна до следующего изменения каталога
+    const std::vector<std::string_view>& GetBusesByStop(std::string_view stop_name) const;
+    
+    // Перебор маршрутов через остановку в порядке имён: func(route_name).
+    // В отличие от GetBusesByStop, не требует объектов предметной области
+    void ForEachBusByStop(std::string_view stop_name, const std::function<void(std::string_view)>& func) const;
+    
     // Получение информации об остановке (координаты)
     const Stop* GetStopByName(const std::string& stop_name) const;
+    bool StopExists(std::string_view stop_name) const;
     
     // Получение информации о маршруте
     RouteInfo GetRouteInfo(const std::string& route_name) const;
     
     // Дополнительные методы для доступа к контейнерам
-    const domain::StopContainer& GetStopContainer() const { return stop_container_; }
-    const domain::RouteContainer& GetRouteContainer() const { return route_container_; }
+    const domain::StopContainer& GetStopContainer() const;
+    const domain::RouteContainer& GetRouteContainer() const;
     
     // Проверка существования
     bool RouteExists(const std::string& route_name) const;
 
     // Получение реального расстояния между остановками
     double GetDistance(const std::string& from, const std::string& to) const;
+    double GetDistance(const Stop* from, const Stop* to) const;
+    
+    // Перебор всех заданных расстояний: func(from, to, distance)
+    template <typename Func>
+    void ForEachDistance(Func func) const {
+        if (image_) {
+            Materialized().ForEachDistance(func);
+            return;
+        }
+        for (const auto& [stops, distance] : distances_) {
+            func(stops.first, stops.second, distance);
+        }
+    }
+
+    // Построение производных индексов (маршруты через остановку, статистика маршрутов)
+    // в thread_count потоках. Результат не зависит от числа потоков.
+    // Без явного вызова индексы строятся в одном потоке при первом запросе.
+    // Уже построенные индексы не перестраиваются: изменения поддерживают их сами
+    void Finalize(size_t thread_count);
+    
+    // Принимает готовые индексы (например, сохранённые в снимке) вместо построения:
+    // маршруты через остановку - представления имён маршрутов этого каталога, упорядоченные
+    // по имени, и статистику каждого маршрута. Далее индексы обновляются как построенные
+    void AdoptIndexes(std::unordered_map<const Stop*, std::vector<std::string_view>> stop_routes,
+                      std::unordered_map<const Route*, RouteInfo> route_infos);
+    
+    // Строит недостающие индексы и делает каталог неизменяемым
+    void Freeze(size_t thread_count = 1);
+    bool IsFrozen() const { return frozen_; }
 
 private:
+    // Хэш пары остановок для таблицы расстояний
+    struct StopPairHasher {
+        size_t operator()(const std::pair<const Stop*, const Stop*>& stops) const {
+            const std::hash<const void*> hasher;
+            return hasher(stops.first) * 37 + hasher(stops.second);
+        }
+    };
+
     // Вспомогательные методы
-    void InvalidateCache() const;
+    static uint64_t NextVersion();
+    void CheckMutable() const;
+    // Полная копия образа, построенная при первом обращении
+    const TransportCatalogue& Materialized() const;
+    bool IndexesBuilt() const;
     void UpdateCache() const;
+    void BuildIndexes(size_t thread_count) const;
+    void BuildStopIndex(const std::vector<const Route*>& routes, size_t thread_count) const;
+    RouteInfo ComputeRouteInfo(const Route* route) const;
+    void SetStop(std::string_view name, geo::Coordinates coordinates);
+    void SetDistance(std::string_view from, std::string_view to, double distance);
+    void StoreDistance(const Stop* from, const Stop* to, double distance);
+    void UnlinkDistance(const Stop* stop, const Stop* neighbour);
+    bool IsStopUsed(const Stop* stop) const;
+    void InsertRoute(std::unique_ptr<Route> route);
+    
+    // Инкрементальное обновление построенных индексов
+    void IndexRoute(const Route* route);
+    void UnindexRoute(const Route* route);
+    void RefreshRoutesThrough(const Stop* stop);
     
 private:
     domain::StopContainer stop_container_;
     domain::RouteContainer route_container_;
     
-    // Кэш для быстрого поиска маршрутов через остановку
-    mutable std::unordered_map<std::string, std::vector<std::string>> stop_to_routes_cache_;
-    mutable bool cache_valid_ = true;
+    // Кэш для быстрого поиска маршрутов через остановку.
+    // Хранит представления имён маршрутов, принадлежащих самим маршрутам
+    mutable std::unordered_map<const Stop*, std::vector<std::string_view>> stop_to_routes_cache_;
+    // Статистика маршрутов, вычисленная при построении индексов
+    mutable std::unordered_map<const Route*, RouteInfo> route_info_cache_;
+    // Признак актуальности индексов. Читается без блокировки, перестроение выполняется
+    // под cache_mutex_, поэтому константные методы можно вызывать из нескольких потоков
+    mutable std::atomic<bool> cache_valid_ = false;
+    mutable std::mutex cache_mutex_;
+    bool frozen_ = false;
+    uint64_t version_ = NextVersion();
+    
+    // Расстояния между остановками, ключ - пара указателей, а не копии имён
+    std::unordered_map<std::pair<const Stop*, const Stop*>, double, StopPairHasher> distances_;
+    // Для каждой остановки - вторые остановки её расстояний в обоих направлениях (по записи
+    // на расстояние), чтобы удаление остановки не просматривало всю таблицу расстояний
+    std::unordered_map<const Stop*, std::vector<const Stop*>> distance_neighbours_;
     
-    // Расстояния между остановками
-    std::unordered_map<std::string, std::unordered_map<std::string, double>> distances_;
+    // Образ, по которому выполняются запросы, и его копия в памяти (только для каталога из образа)
+    std::shared_ptr<const serialization::CatalogueImage> image_;
+    mutable std::unique_ptr<TransportCatalogue> materialized_;
+    mutable std::once_flag materialize_once_;
 };
 
 } // namespace transport_catalogue
\ No newline at end of file
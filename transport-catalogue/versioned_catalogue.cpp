@@ -0,0 +1,53 @@
+#include "versioned_catalogue.h"
+
+#ifdef DEBUG_PRINT
+#undef DEBUG_PRINT
+#endif
+#define DEBUG_PRINT(x) \
+    do                 \
+    {                  \
+    } while (0)
+
+#include <stdexcept>
+
+namespace transport_catalogue
+{
+
+    VersionedCatalogue::VersionedCatalogue(std::unique_ptr<TransportCatalogue> initial)
+    {
+        if (!initial)
+        {
+            throw std::invalid_argument("Initial catalogue is null");
+        }
+        initial->Freeze();
+        std::atomic_store(&current_, Snapshot(std::move(initial)));
+        version_.store(1, std::memory_order_release);
+    }
+
+    VersionedCatalogue::Snapshot VersionedCatalogue::Acquire() const
+    {
+        return std::atomic_load(&current_);
+    }
+
+    uint64_t VersionedCatalogue::GetVersion() const
+    {
+        return version_.load(std::memory_order_acquire);
+    }
+
+    uint64_t VersionedCatalogue::Update(const Change &change, size_t thread_count)
+    {
+        std::lock_guard lock(writer_mutex_);
+
+        // Копия строится без блокировки читателей: текущая версия неизменяема
+        std::unique_ptr<TransportCatalogue> next = Acquire()->Clone();
+        change(*next);
+        next->Freeze(thread_count);
+
+        std::atomic_store(&current_, Snapshot(std::move(next)));
+        const uint64_t version = version_.load(std::memory_order_relaxed) + 1;
+        version_.store(version, std::memory_order_release);
+        DEBUG_PRINT("Published catalogue version " << version);
+        return version;
+    }
+
+} // namespace transport_catalogue
@@ -0,0 +1,49 @@
+#pragma once
+
+/*
+ * Версионированный каталог: чтение и изменение без взаимных блокировок.
+ * Читатели получают неизменяемый снимок текущей версии и работают с ним сколько угодно долго.
+ * Писатель изменяет копию текущей версии и публикует её атомарной заменой указателя.
+ * Старая версия освобождается, когда завершается последний читатель, удерживающий её снимок.
+ */
+
+#include "transport_catalogue.h"
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+
+namespace transport_catalogue
+{
+
+    class VersionedCatalogue
+    {
+    public:
+        using Snapshot = std::shared_ptr<const TransportCatalogue>;
+        using Change = std::function<void(TransportCatalogue &)>;
+
+        // Начальная версия замораживается и становится версией 1
+        explicit VersionedCatalogue(std::unique_ptr<TransportCatalogue> initial);
+
+        // Снимок текущей версии. Не блокируется писателями; снимок остаётся
+        // действительным и после публикации новых версий
+        Snapshot Acquire() const;
+
+        // Номер последней опубликованной версии
+        uint64_t GetVersion() const;
+
+        // Применяет change к копии текущей версии, строит её индексы в thread_count потоках
+        // и публикует. Писатели выполняются по очереди. Если change выбрасывает исключение,
+        // текущая версия не меняется. Возвращает номер опубликованной версии
+        uint64_t Update(const Change &change, size_t thread_count = 1);
+
+    private:
+        // Доступ только через std::atomic_load/std::atomic_store
+        Snapshot current_;
+        std::atomic<uint64_t> version_ = 0;
+        std::mutex writer_mutex_;
+    };
+
+} // namespace transport_catalogue